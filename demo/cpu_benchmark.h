@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../3rd/imgui/imgui.h"
+#include "../nes/bus.h"
+#include <chrono>
+#include <format>
+#include <string>
+
+// 对比几种解释器分派方式的执行速度
+class cpu_benchmark {
+  public:
+    cpu_benchmark() {
+        ImGui::Begin("cpu benchmark");
+        ImGui::InputInt("cycles (M)", &cycle_count);
+        if (ImGui::Button("run")) {
+            result_str = std::format("table:    {:.2f} ns/cycle\nthreaded: {:.2f} ns/cycle\ncached:   {:.2f} ns/cycle\n",
+                                     measure(dispatch_mode::table), measure(dispatch_mode::threaded), measure(dispatch_mode::cached));
+        }
+        ImGui::Text("%s", result_str.c_str());
+        ImGui::End();
+    }
+
+  private:
+    // 在 ram 中执行一段死循环程序，返回每个周期的平均耗时
+    static auto measure(dispatch_mode mode) -> double {
+        load_program();
+        auto c = cpu{bus_, mode};
+        const auto n = static_cast<uint32_t>(cycle_count) * 1'000'000;
+        const auto begin = std::chrono::steady_clock::now();
+        c.run_cycles(n);
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / n;
+    }
+
+    static auto load_program() -> void {
+        constexpr uint8_t program[] = {
+            0xa2, 0x00,       // LDX #$00
+            0xe8,             // INX
+            0x8a,             // TXA
+            0x69, 0x07,       // ADC #$07
+            0x0a,             // ASL A
+            0x95, 0x50,       // STA $50,X
+            0x4a,             // LSR A
+            0x29, 0x3f,       // AND #$3f
+            0xc5, 0x40,       // CMP $40
+            0xe6, 0x41,       // INC $41
+            0xd0, 0x01,       // BNE +1
+            0xea,             // NOP
+            0x4c, 0x02, 0x00, // JMP $0002
+        };
+        for (auto i = 0; i < sizeof(program); ++i) {
+            bus_.ram()[i] = program[i];
+        }
+    }
+
+  private:
+    static inline bus bus_{};
+    static inline int cycle_count = 200;
+    static inline std::string result_str;
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "../3rd/imgui/imgui.h"
-#include "../nes/bus.h"
+#include "../nes/cpu_bus.h"
 #include <format>
 #include <iostream>
 
@@ -137,8 +137,8 @@ class cpu_emulator {
     static auto read_inst_str() -> void {
         inst_str.clear();
         for (int i = 0, pc = cpu_.pc(); i < 10; ++i) {
-            inst_str += "    " + cpu::inst_str(bus_.ram(), pc);
-            pc += cpu::inst_len(cpu::inst_table[bus_.ram()[pc]]);
+            inst_str += "    " + decltype(cpu_)::inst_str(bus_.ram(), pc);
+            pc += decltype(cpu_)::inst_len(bus_.ram()[pc]);
         }
         inst_str[0] = '-';
         inst_str[1] = '>';
@@ -161,7 +161,7 @@ class cpu_emulator {
 
   private:
     static inline cpu_bus bus_{};
-    static inline cpu cpu_{bus_};
+    static inline basic_cpu<cpu_bus> cpu_{bus_};
     static inline char hex_bincode[64 * 1024 * 2]{};
     static inline int ram_str_start;
     static inline std::string ram_str;  // 内存字符串
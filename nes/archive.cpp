@@ -0,0 +1,370 @@
+#include "archive.h"
+#include "hash.h"
+#include <array>
+#include <cstring>
+
+// deflate 解压（rfc 1951），gzip（rfc 1952）与 zip 只解析到找到压缩数据为止
+namespace {
+
+class bit_reader {
+  public:
+    explicit bit_reader(std::span<const uint8_t> in) : in_(in) {}
+
+    // 读取 n 位，n <= 32。超出输入时补 0 并记录错误
+    auto bits(int n) -> uint32_t {
+        while (count_ < n) {
+            if (pos_ < in_.size()) {
+                buf_ |= uint64_t{in_[pos_]} << count_;
+            } else {
+                overrun_ = true;
+            }
+            ++pos_;
+            count_ += 8;
+        }
+        const auto v = static_cast<uint32_t>(buf_ & ((uint64_t{1} << n) - 1));
+        buf_ >>= n;
+        count_ -= n;
+        return v;
+    }
+    auto align() -> void { bits(count_ % 8); } // 丢弃到字节边界
+    auto overrun() const -> bool { return overrun_; }
+
+  private:
+    std::span<const uint8_t> in_;
+    size_t pos_{};
+    uint64_t buf_{};
+    int count_{};
+    bool overrun_{};
+};
+
+// 规范哈夫曼码，按码长从短到长逐位匹配
+struct huffman {
+    static constexpr auto max_bits = 15;
+
+    std::array<uint16_t, max_bits + 1> count{}; // 每种码长的符号数
+    std::array<uint16_t, 288> symbol{};         // 按码排序的符号
+
+    // 码长超额时返回 false，不完整的码表是允许的（只有一个距离码的情况）
+    auto build(std::span<const uint8_t> lengths) -> bool {
+        count.fill(0);
+        for (const auto l : lengths) {
+            ++count[l];
+        }
+        auto left = 1;
+        for (auto len = 1; len <= max_bits; ++len) {
+            left = left * 2 - count[len];
+            if (left < 0) {
+                return false;
+            }
+        }
+        auto offs = std::array<uint16_t, max_bits + 1>{};
+        for (auto len = 1; len < max_bits; ++len) {
+            offs[len + 1] = offs[len] + count[len];
+        }
+        for (auto s = 0u; s < lengths.size(); ++s) {
+            if (lengths[s] != 0) {
+                symbol[offs[lengths[s]]++] = static_cast<uint16_t>(s);
+            }
+        }
+        count[0] = 0;
+        return true;
+    }
+
+    auto decode(bit_reader &br) const -> int {
+        auto code = 0, first = 0, index = 0;
+        for (auto len = 1; len <= max_bits; ++len) {
+            code |= static_cast<int>(br.bits(1));
+            const auto n = count[len];
+            if (code - n < first) {
+                return symbol[index + (code - first)];
+            }
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+};
+
+constexpr uint16_t len_base[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t len_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t dist_base[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t dist_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+class inflater {
+  public:
+    inflater(std::span<const uint8_t> in, std::span<uint8_t> out) : br_(in), out_(out) {}
+
+    // 解压全部数据块，输出必须正好填满 out
+    auto run() -> bool {
+        auto last = false;
+        while (!last) {
+            last = br_.bits(1);
+            auto ok = false;
+            switch (br_.bits(2)) {
+                case 0:
+                    ok = stored();
+                    break;
+                case 1:
+                    ok = fixed();
+                    break;
+                case 2:
+                    ok = dynamic();
+                    break;
+                default:
+                    break;
+            }
+            if (!ok || br_.overrun()) {
+                return false;
+            }
+        }
+        return pos_ == out_.size();
+    }
+
+  private:
+    auto stored() -> bool {
+        br_.align();
+        const auto len = br_.bits(16);
+        const auto nlen = br_.bits(16);
+        if ((len ^ 0xffff) != nlen || out_.size() - pos_ < len) {
+            return false;
+        }
+        for (auto i = 0u; i < len; ++i) {
+            out_[pos_++] = static_cast<uint8_t>(br_.bits(8));
+        }
+        return true;
+    }
+
+    auto fixed() -> bool {
+        static const auto tables = [] {
+            auto t = std::array<huffman, 2>{};
+            auto lengths = std::array<uint8_t, 288>{};
+            std::memset(lengths.data(), 8, 144);
+            std::memset(lengths.data() + 144, 9, 112);
+            std::memset(lengths.data() + 256, 7, 24);
+            std::memset(lengths.data() + 280, 8, 8);
+            t[0].build(lengths);
+            std::memset(lengths.data(), 5, 30);
+            t[1].build({lengths.data(), 30});
+            return t;
+        }();
+        return codes(tables[0], tables[1]);
+    }
+
+    auto dynamic() -> bool {
+        constexpr uint8_t order[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        const auto nlen = br_.bits(5) + 257;
+        const auto ndist = br_.bits(5) + 1;
+        const auto ncode = br_.bits(4) + 4;
+        if (nlen > 286 || ndist > 30) {
+            return false;
+        }
+
+        auto lengths = std::array<uint8_t, 320>{};
+        for (auto i = 0u; i < ncode; ++i) {
+            lengths[order[i]] = static_cast<uint8_t>(br_.bits(3));
+        }
+        auto lencode = huffman{}, distcode = huffman{};
+        if (!lencode.build({lengths.data(), 19})) {
+            return false;
+        }
+
+        // 码长本身也经过哈夫曼编码，16 ~ 18 为重复
+        lengths.fill(0);
+        for (auto i = 0u; i < nlen + ndist;) {
+            const auto sym = lencode.decode(br_);
+            if (sym < 0 || br_.overrun()) {
+                return false;
+            }
+            if (sym < 16) {
+                lengths[i++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+            auto len = uint8_t{};
+            auto repeat = 0u;
+            if (sym == 16) {
+                if (i == 0) {
+                    return false;
+                }
+                len = lengths[i - 1];
+                repeat = 3 + br_.bits(2);
+            } else if (sym == 17) {
+                repeat = 3 + br_.bits(3);
+            } else {
+                repeat = 11 + br_.bits(7);
+            }
+            if (i + repeat > nlen + ndist) {
+                return false;
+            }
+            while (repeat--) {
+                lengths[i++] = len;
+            }
+        }
+        if (lengths[256] == 0) { // 必须有块结束符
+            return false;
+        }
+        return lencode.build({lengths.data(), nlen}) && distcode.build({lengths.data() + nlen, ndist}) &&
+               codes(lencode, distcode);
+    }
+
+    auto codes(const huffman &lencode, const huffman &distcode) -> bool {
+        while (true) {
+            auto sym = lencode.decode(br_);
+            if (sym < 0 || br_.overrun()) {
+                return false;
+            }
+            if (sym < 256) {
+                if (pos_ == out_.size()) {
+                    return false;
+                }
+                out_[pos_++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+            if (sym == 256) {
+                return true;
+            }
+            sym -= 257;
+            if (sym >= 29) {
+                return false;
+            }
+            const auto len = len_base[sym] + br_.bits(len_extra[sym]);
+            const auto dsym = distcode.decode(br_);
+            if (dsym < 0 || dsym >= 30) {
+                return false;
+            }
+            const auto dist = dist_base[dsym] + br_.bits(dist_extra[dsym]);
+            if (dist > pos_ || out_.size() - pos_ < len) {
+                return false;
+            }
+            // 距离可能小于长度，需要逐字节复制
+            for (auto i = 0u; i < len; ++i, ++pos_) {
+                out_[pos_] = out_[pos_ - dist];
+            }
+        }
+    }
+
+  private:
+    bit_reader br_;
+    std::span<uint8_t> out_;
+    size_t pos_{};
+};
+
+auto load_le16(const uint8_t *p) -> uint32_t {
+    return p[0] | (p[1] << 8);
+}
+
+auto load_le32(const uint8_t *p) -> uint32_t {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// 解压 method 方式（0 不压缩，8 deflate）的数据，大小与 crc 由容器给出
+auto unpack(std::span<const uint8_t> in, int method, size_t size, uint32_t crc) -> std::optional<std::vector<uint8_t>> {
+    constexpr auto max_size = size_t{64} << 20; // 远大于任何 nes rom，避免损坏的大小字段导致巨大的分配
+    if (size == 0 || size > max_size) {
+        return {};
+    }
+    auto out = std::vector<uint8_t>(size);
+    if (method == 0) {
+        if (in.size() < size) {
+            return {};
+        }
+        std::memcpy(out.data(), in.data(), size);
+    } else if (method != 8 || !inflater{in, out}.run()) {
+        return {};
+    }
+    if (crc32(out) != crc) {
+        return {};
+    }
+    return out;
+}
+
+auto extract_gzip(std::span<const uint8_t> data) -> std::optional<std::vector<uint8_t>> {
+    if (data.size() < 18 || data[2] != 8) {
+        return {};
+    }
+    const auto flags = data[3];
+    auto pos = size_t{10};
+    if (flags & 0x04) { // FEXTRA
+        if (data.size() < pos + 2) {
+            return {};
+        }
+        pos += 2 + load_le16(&data[pos]);
+    }
+    for (const auto f : {0x08, 0x10}) { // FNAME、FCOMMENT，以 0 结尾
+        if (flags & f) {
+            while (pos < data.size() && data[pos] != 0) {
+                ++pos;
+            }
+            ++pos;
+        }
+    }
+    if (flags & 0x02) { // FHCRC
+        pos += 2;
+    }
+    if (pos + 8 > data.size()) {
+        return {};
+    }
+    // 只支持单个成员，尾部的 crc 与原始大小（模 2^32）位于文件的最后 8 字节
+    const auto trailer = data.data() + data.size() - 8;
+    return unpack(data.subspan(pos, data.size() - 8 - pos), 8, load_le32(trailer + 4), load_le32(trailer));
+}
+
+auto extract_zip(std::span<const uint8_t> data) -> std::optional<std::vector<uint8_t>> {
+    // 从尾部向前查找中央目录结束记录，其后最多有 65535 字节的注释
+    constexpr auto eocd_size = size_t{22};
+    if (data.size() < eocd_size) {
+        return {};
+    }
+    auto eocd = std::optional<size_t>{};
+    const auto lowest = data.size() > eocd_size + 0xffff ? data.size() - eocd_size - 0xffff : 0;
+    for (auto i = data.size() - eocd_size + 1; i-- > lowest;) {
+        if (load_le32(&data[i]) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (!eocd || load_le16(&data[*eocd + 10]) != 1) { // 只支持一个文件
+        return {};
+    }
+
+    const auto dir = static_cast<size_t>(load_le32(&data[*eocd + 16]));
+    if (dir + 46 > data.size() || load_le32(&data[dir]) != 0x02014b50) {
+        return {};
+    }
+    const auto flags = load_le16(&data[dir + 8]);
+    const auto method = static_cast<int>(load_le16(&data[dir + 10]));
+    const auto crc = load_le32(&data[dir + 16]);
+    const auto packed = static_cast<size_t>(load_le32(&data[dir + 20]));
+    const auto size = static_cast<size_t>(load_le32(&data[dir + 24]));
+    const auto local = static_cast<size_t>(load_le32(&data[dir + 42]));
+    if (flags & 0x01) { // 加密
+        return {};
+    }
+
+    if (local + 30 > data.size() || load_le32(&data[local]) != 0x04034b50) {
+        return {};
+    }
+    const auto start = local + 30 + load_le16(&data[local + 26]) + load_le16(&data[local + 28]);
+    if (start > data.size() || data.size() - start < packed) {
+        return {};
+    }
+    return unpack(data.subspan(start, packed), method, size, crc);
+}
+
+} // namespace
+
+auto is_archive(std::span<const uint8_t> data) -> bool {
+    return data.size() >= 4 && ((data[0] == 0x1f && data[1] == 0x8b) || load_le32(data.data()) == 0x04034b50);
+}
+
+auto extract_archive(std::span<const uint8_t> data) -> std::optional<std::vector<uint8_t>> {
+    if (data.size() >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        return extract_gzip(data);
+    }
+    if (data.size() >= 4 && load_le32(data.data()) == 0x04034b50) {
+        return extract_zip(data);
+    }
+    return {};
+}
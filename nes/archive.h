@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// 压缩的 rom 文件：gzip（.nes.gz）或只含一个文件的 zip，按文件头的标识判断
+auto is_archive(std::span<const uint8_t> data) -> bool;
+
+// 解压到一块按解压后大小一次分配的缓冲区，不经过临时文件。
+// 格式不支持、数据损坏或 crc 校验失败时返回空
+auto extract_archive(std::span<const uint8_t> data) -> std::optional<std::vector<uint8_t>>;
@@ -0,0 +1,75 @@
+#include "bg_row.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NES_BG_SIMD 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NES_BG_SIMD 1
+#endif
+
+namespace {
+
+// 背景从第几个像素开始显示，256 表示关闭
+auto bg_start(ppu_reg_mask mask) -> uint32_t {
+    return mask.showbg ? (mask.showbg_l ? 0u : 8u) : 256u;
+}
+
+#ifdef NES_BG_SIMD
+// 每个图块的属性乘 4 后展开成 8 个像素：16 个属性经过三次自身交错得到 128 字节
+auto expand_attr(const uint8_t *attr, uint8_t *out) -> void {
+    for (auto c = 0; c < 32; c += 16) {
+        const auto a = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(attr + c)), 2);
+        const __m128i x2[2] = {_mm_unpacklo_epi8(a, a), _mm_unpackhi_epi8(a, a)};
+        for (auto i = 0; i < 2; ++i) {
+            const __m128i x4[2] = {_mm_unpacklo_epi16(x2[i], x2[i]), _mm_unpackhi_epi16(x2[i], x2[i])};
+            for (auto j = 0; j < 2; ++j) {
+                auto *dst = reinterpret_cast<__m128i *>(out + c * 8 + i * 64 + j * 32);
+                _mm_storeu_si128(dst, _mm_unpacklo_epi32(x4[j], x4[j]));
+                _mm_storeu_si128(dst + 1, _mm_unpackhi_epi32(x4[j], x4[j]));
+            }
+        }
+    }
+    std::memset(out + 256, attr[32] << 2, 8);
+}
+#endif
+
+} // namespace
+
+auto compose_bg_row_scalar(const uint8_t *pattern, const uint8_t *attr, uint32_t fine_x, ppu_reg_mask mask, uint8_t *out) -> void {
+    const auto from = bg_start(mask);
+    for (auto x = 0u; x < 256; ++x) {
+        const auto p = x + fine_x;
+        out[x] = x < from ? 0 : static_cast<uint8_t>(pattern[p] | (attr[p >> 3] << 2));
+    }
+}
+
+// 展开属性后按 fine_x 的偏移做非对齐读取，与图案按位或即为调色板下标，avx2 每次 32 个像素
+auto compose_bg_row(const uint8_t *pattern, const uint8_t *attr, uint32_t fine_x, ppu_reg_mask mask, uint8_t *out) -> void {
+#ifdef NES_BG_SIMD
+    const auto from = bg_start(mask);
+    if (from >= 256) {
+        std::memset(out, 0, 256);
+        return;
+    }
+    alignas(16) uint8_t expanded[33 * 8];
+    expand_attr(attr, expanded);
+#ifdef __AVX2__
+    for (auto x = 0u; x < 256; x += 32) {
+        const auto p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pattern + fine_x + x));
+        const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(expanded + fine_x + x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x), _mm256_or_si256(p, a));
+    }
+#else
+    for (auto x = 0u; x < 256; x += 16) {
+        const auto p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern + fine_x + x));
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(expanded + fine_x + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_or_si128(p, a));
+    }
+#endif
+    std::memset(out, 0, from);
+#else
+    compose_bg_row_scalar(pattern, attr, fine_x, mask, out);
+#endif
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "ppu.h"
+#include <cstdint>
+
+// 整行绘制的背景组合：pattern 为图块流中每个像素的图案（0 ~ 3），至少 33 个图块共 264 字节；
+// attr 为每个图块的属性（0 ~ 3），至少 33 项。从 fine_x 开始取 256 个像素，输出背景调色板下标
+// （属性 * 4 + 图案），按 mask 关闭背景或裁掉最左边 8 个像素时输出 0
+auto compose_bg_row(const uint8_t *pattern, const uint8_t *attr, uint32_t fine_x, ppu_reg_mask mask, uint8_t *out) -> void;
+
+// 逐像素的参考实现，也是没有 sse2 时的实现
+auto compose_bg_row_scalar(const uint8_t *pattern, const uint8_t *attr, uint32_t fine_x, ppu_reg_mask mask, uint8_t *out) -> void;
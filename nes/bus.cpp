@@ -1,19 +1,330 @@
 #include "bus.h"
-#include <utility>
+#include <algorithm>
+#include <type_traits>
 
-auto bus::cpu_bus_write(uint16_t addr, uint8_t data) -> void {
-    if (addr <= 0x1FFF) {
-        ram_[addr & 0x7ff] = data;
-    } else if (addr <= 0x1FFF) {
-        ppu_.cpu_bus_write(addr, data);
+// 0x0000 ~ 0x1fff  ram，2KB 镜像 4 次
+// 0x2000 ~ 0x3fff  ppu 寄存器，8 字节镜像
+// 0x4000 ~ 0x401f  apu 与 io 寄存器
+// 0x4020 ~ 0x5fff  扩展区域
+// 0x6000 ~ 0x7fff  prg ram
+// 0x8000 ~ 0xffff  prg rom，写入为 mapper 寄存器
+template <typename Mapper>
+auto basic_bus<Mapper>::map_pages() -> void {
+    for (auto i = 0; i < 0x20; ++i) {
+        pages_[i] = {ram_.data() + ((i & 0x7) << 8), ram_.data() + ((i & 0x7) << 8), nullptr, nullptr};
+    }
+    for (auto i = 0x20; i < 0x40; ++i) {
+        pages_[i] = {nullptr, nullptr, &basic_bus::read_ppu, &basic_bus::write_ppu};
+    }
+    pages_[0x40] = {nullptr, nullptr, &basic_bus::read_io, &basic_bus::write_io};
+    for (auto i = 0x41; i < 0x60; ++i) {
+        pages_[i] = {nullptr, nullptr, &basic_bus::open_bus, &basic_bus::ignore};
+    }
+    map_prg_ram();
+    map_prg();
+}
+
+// prg ram 属于卡带，映射到文件时写入需要记录脏页，读取仍然直接访问
+template <typename Mapper>
+auto basic_bus<Mapper>::map_prg_ram() -> void {
+    auto *sram = cart_ && cart_->valid() ? &cart_->prg_ram() : nullptr;
+    for (auto i = 0x60; i < 0x80; ++i) {
+        if (!sram) {
+            pages_[i] = {nullptr, nullptr, &basic_bus::open_bus, &basic_bus::ignore};
+            continue;
+        }
+        const auto p = sram->data() + ((i - 0x60) << 8);
+        if (sram->persistent()) {
+            pages_[i] = {p, nullptr, nullptr, &basic_bus::write_save};
+        } else {
+            pages_[i] = {p, p, nullptr, nullptr};
+        }
+    }
+    cpu_.invalidate_code(0x6000, 0x7fff);
+}
+
+// 按 mapper 的 8KB 窗口重新填写 prg 页，只有指向改变的窗口需要使已译码的代码失效
+template <typename Mapper>
+auto basic_bus<Mapper>::map_prg() -> void {
+    for (auto slot = 0; slot < 4; ++slot) {
+        const auto first = 0x80 + slot * 0x20;
+        const auto bank = cart_ && cart_->valid() ? cart_->prg_bank(slot) : nullptr;
+        if (pages_[first].read == bank && pages_[first].write_io) {
+            continue;
+        }
+        for (auto i = 0; i < 0x20; ++i) {
+            pages_[first + i] = {bank ? bank + (i << 8) : nullptr, nullptr, &basic_bus::open_bus, &basic_bus::write_prg};
+        }
+        cpu_.invalidate_code(first << 8, (first << 8) + 0x1fff);
+    }
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::load_cartridget(std::shared_ptr<cartridge> cart) -> void {
+    cart_ = cart;
+    if constexpr (std::is_same_v<Mapper, mapper>) {
+        mapper_ = cart_ ? &cart_->mapper_state() : nullptr;
+    } else {
+        mapper_ = cart_ ? std::get_if<Mapper>(&cart_->mapper_state()) : nullptr;
+    }
+    ppu_.connect(cart_.get(), vram_.data());
+    map_prg_ram();
+    map_prg();
+    start_frames();
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::trap_writes(uint16_t addr) -> void {
+    const auto page = (addr >> 8) & 0x7;
+    for (auto i = page; i < 0x20; i += 0x8) {
+        pages_[i].write = nullptr;
+        pages_[i].write_io = &basic_bus::write_code;
+    }
+}
+
+// ppu 在访问寄存器前追赶到当前指令开始的时刻
+template <typename Mapper>
+auto basic_bus<Mapper>::read_ppu(basic_bus &b, uint16_t addr) -> uint8_t {
+    return b.ppu_.cpu_bus_read(addr, b.master_clock());
+}
+
+// vblank 期间打开 nmi 会立即产生一次 nmi，在当前指令结束后处理
+template <typename Mapper>
+auto basic_bus<Mapper>::write_ppu(basic_bus &b, uint16_t addr, uint8_t data) -> void {
+    const auto nmi = b.ppu_.nmi_enabled();
+    b.ppu_.cpu_bus_write(addr, data, b.master_clock());
+    if (!nmi && b.ppu_.nmi_enabled() && b.ppu_.in_vblank()) {
+        b.schedule(event::nmi, b.master_clock());
+    }
+    if ((addr & 0x7) != 7) {
+        b.post_sprite0();
+    }
+}
+
+// apu 只实现了帧计数器中断，手柄尚未实现，0x4020 之后属于扩展区域
+template <typename Mapper>
+auto basic_bus<Mapper>::read_io(basic_bus &b, uint16_t addr) -> uint8_t {
+    if (addr == 0x4015) {
+        const auto stat = static_cast<uint8_t>(b.apu_frame_irq_ << 6);
+        b.apu_frame_irq_ = false;
+        return stat;
+    }
+    return open_bus(b, addr);
+}
+
+// oam dma 立即复制整页，cpu 暂停 513 个周期，奇数周期开始时再多等一个
+template <typename Mapper>
+auto basic_bus<Mapper>::write_io(basic_bus &b, uint16_t addr, uint8_t data) -> void {
+    if (addr == 0x4014) {
+        auto page = std::array<uint8_t, 256>{};
+        for (auto i = 0; i < 256; ++i) {
+            page[i] = b.cpu_bus_read((data << 8) | i);
+        }
+        b.ppu_.run_to(b.master_clock());
+        b.ppu_.oam_dma(page.data());
+        b.post_sprite0();
+        b.cpu_.stall(513 + (b.cpu_.clocks() & 1));
+    } else if (addr == 0x4017) {
+        b.apu_frame_ctrl_ = data;
+        if (data & 0x40) {
+            b.apu_frame_irq_ = false;
+        }
+        b.schedule_apu_frame(b.master_clock());
+    }
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::write_code(basic_bus &b, uint16_t addr, uint8_t data) -> void {
+    b.ram_[addr & 0x7ff] = data;
+    b.cpu_.ram_written(addr);
+}
+
+// mapper 寄存器，切换 bank 后重新映射。chr bank 与镜像方式可能改变，ppu 先追赶到当前时刻
+template <typename Mapper>
+auto basic_bus<Mapper>::write_prg(basic_bus &b, uint16_t addr, uint8_t data) -> void {
+    if (!b.mapper_) {
+        return;
+    }
+    b.ppu_.run_to(b.master_clock());
+    if constexpr (std::is_same_v<Mapper, mapper>) {
+        std::visit([&](auto &m) { m.write(b.cart_->banks(), addr, data); }, *b.mapper_);
+    } else {
+        b.mapper_->write(b.cart_->banks(), addr, data);
+    }
+    if constexpr (!fixed_prg_mapper<Mapper>) {
+        b.map_prg();
+    }
+    b.ppu_.invalidate();
+    b.post_sprite0();
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::write_save(basic_bus &b, uint16_t addr, uint8_t data) -> void {
+    auto &sram = b.cart_->prg_ram();
+    sram.data()[addr - 0x6000] = data;
+    sram.mark_dirty(addr - 0x6000);
+}
+
+// 未连接的地址读到数据线上残留的值，通常是指令中地址的高字节
+template <typename Mapper>
+auto basic_bus<Mapper>::open_bus(basic_bus & /*b*/, uint16_t addr) -> uint8_t {
+    return addr >> 8;
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::ignore(basic_bus & /*b*/, uint16_t /*addr*/, uint8_t /*data*/) -> void {
+}
+
+// 制式在加载卡带时确定，之后的事件时刻都由 ppu 从它当前的位置推算
+template <typename Mapper>
+auto basic_bus<Mapper>::start_frames() -> void {
+    timing_ = &timing_of(cart_ && cart_->valid() ? cart_->info().timing : tv_system::ntsc);
+    sched_.clear();
+    scanline_ = 0;
+    ppu_.reset_timing(*timing_, master_clock());
+    schedule_frame();
+    if (counts_scanlines()) {
+        sched_.schedule(event::scanline, ppu_.time_at(0, ppu_.a12_dot()));
+    }
+    schedule_apu_frame(master_clock());
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::schedule_frame() -> void {
+    sched_.schedule(event::vblank, ppu_.time_at(clock_timing::vblank_line, 1));
+    sched_.schedule(event::vblank_end, ppu_.time_at(timing_->prerender_line(), 1));
+    post_sprite0();
+}
+
+// 预测在 ppu 寄存器、oam 或 mapper 改变后重新计算。$2007 的写入太频繁，只让预测失效，
+// 事件在下一次预渲染行重新安排，期间读取 $2002 仍然按新的预测判断是否需要追赶
+template <typename Mapper>
+auto basic_bus<Mapper>::post_sprite0() -> void {
+    const auto time = ppu_.sprite0_time();
+    if (time == scheduler::never) {
+        sched_.cancel(event::sprite0);
+    } else if (time != sched_.time_of(event::sprite0)) {
+        schedule(event::sprite0, time);
+    }
+}
+
+// 4 步模式每 apu_frame 个 cpu 周期产生一次中断，5 步模式或禁止中断时不安排
+template <typename Mapper>
+auto basic_bus<Mapper>::schedule_apu_frame(uint64_t time) -> void {
+    if (apu_frame_ctrl_ & 0xc0) {
+        sched_.cancel(event::apu_frame);
+    } else {
+        schedule(event::apu_frame, time + uint64_t{timing_->apu_frame} * timing_->cpu_div);
+    }
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::schedule(event e, uint64_t time) -> void {
+    sched_.schedule(e, time);
+    cpu_.limit_deadline((time + timing_->cpu_div - 1) / timing_->cpu_div);
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::run_until(uint64_t time) -> void {
+    while (master_clock() < time) {
+        run_batch(time);
+    }
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::run_frame() -> void {
+    for (const auto frame = frame_; frame_ == frame;) {
+        run_batch(scheduler::never);
+    }
+}
+
+// cpu 执行到下一个事件或 time，然后处理到期的事件，最后检查中断线。
+// 中断线有效但被屏蔽时照常批量执行，cli、plp、rti 清除 i 时 cpu 提前结束本次执行，之后尽快响应
+template <typename Mapper>
+auto basic_bus<Mapper>::run_batch(uint64_t time) -> void {
+    const auto next = std::min(time, sched_.next_time());
+    const auto deadline = next / timing_->cpu_div + (next % timing_->cpu_div != 0);
+    if (ppu_sync_ == ppu_sync::stepped) {
+        run_stepped(next);
+    } else {
+        cpu_.run_to(deadline);
+    }
+    while (const auto e = sched_.pop(master_clock())) {
+        dispatch(e->e, e->time);
+    }
+    if (irq_line()) {
+        cpu_.irq();
     }
 }
 
-auto bus::cpu_bus_read(uint16_t addr) -> uint8_t {
-    if (addr <= 0x1FFF) {
-        return ram_[addr & 0x7ff];
-    } else if (addr <= 0x3FFF) {
-        return ppu_.cpu_bus_read(addr);
+// 参考模式：cpu 逐周期执行，每个周期后 ppu 追赶一次，在指令边界检查事件与中断
+template <typename Mapper>
+auto basic_bus<Mapper>::run_stepped(uint64_t time) -> void {
+    do {
+        cpu_.next_clock();
+        ppu_.run_to(master_clock());
+    } while (cpu_.cycles_left() != 0 ||
+             (master_clock() < std::min(time, sched_.next_time()) && !(irq_line() && !cpu_.r_stat_.I)));
+}
+
+// ppu 自己设置状态标志并产生 a12 信号，事件只让它追赶到对应的时刻
+template <typename Mapper>
+auto basic_bus<Mapper>::dispatch(event e, uint64_t time) -> void {
+    switch (e) {
+        case event::vblank:
+            ppu_.run_to(time);
+            ++frame_;
+            if (ppu_.nmi_enabled() && ppu_.in_vblank()) {
+                cpu_.nmi();
+            }
+            break;
+        case event::vblank_end:
+            ppu_.run_to(time);
+            schedule_frame();
+            break;
+        case event::nmi:
+            if (ppu_.nmi_enabled() && ppu_.in_vblank()) {
+                cpu_.nmi();
+            }
+            break;
+        case event::sprite0:
+            ppu_.run_to(time);
+            post_sprite0(); // 当前行的预测是保守的，可能还没有命中
+            break;
+        case event::scanline:
+            // 可见行与预渲染行各有一次 a12 上升沿
+            ppu_.run_to(time);
+            if (scanline_ == timing_->prerender_line()) {
+                scanline_ = 0;
+            } else {
+                scanline_ = scanline_ == 239 ? timing_->prerender_line() : scanline_ + 1;
+            }
+            sched_.schedule(event::scanline, ppu_.time_at(scanline_, ppu_.a12_dot()));
+            break;
+        case event::apu_frame:
+            apu_frame_irq_ = true;
+            schedule_apu_frame(time);
+            break;
+        case event::dmc:
+        case event::count:
+            break;
     }
-    std::unreachable();
-}
\ No newline at end of file
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::irq_line() -> bool {
+    return apu_frame_irq_ || (cart_ && cart_->irq());
+}
+
+template <typename Mapper>
+auto basic_bus<Mapper>::counts_scanlines() -> bool {
+    if constexpr (std::is_same_v<Mapper, mapper>) {
+        return mapper_ && std::visit([](auto &m) { return scanline_mapper<std::decay_t<decltype(m)>>; }, *mapper_);
+    } else {
+        return scanline_mapper<Mapper> && mapper_;
+    }
+}
+
+#define NES_INSTANTIATE_BUS(B) template class B;
+NES_FOR_EACH_BUS(NES_INSTANTIATE_BUS)
+#undef NES_INSTANTIATE_BUS
@@ -2,31 +2,133 @@
 #include "cartridge.h"
 #include "cpu.h"
 #include "ppu.h"
+#include "scheduler.h"
 #include <array>
 #include <cstdint>
 #include <memory>
 
-class bus {
+// cpu 地址空间中 256 字节的一页
+template <typename Bus>
+struct bus_page {
+    using read_handler = uint8_t (*)(Bus &, uint16_t);
+    using write_handler = void (*)(Bus &, uint16_t, uint8_t);
+
+    const uint8_t *read{};    // 可直接读取的内存，nullptr 时调用 read_io
+    uint8_t *write{};         // 可直接写入的内存，nullptr 时调用 write_io
+    read_handler read_io{};   // io 寄存器等有副作用的读取
+    write_handler write_io{}; // io 寄存器、mapper 寄存器等有副作用的写入
+};
+
+// ppu 与 cpu 的同步方式
+enum class ppu_sync : uint8_t {
+    catch_up, // 只在访问寄存器、事件到期时追赶，默认
+    stepped,  // cpu 每执行一个周期 ppu 追赶一次，用于验证追赶模式
+};
+
+// 以 mapper 类型为参数的主机，mapper 为 std::variant 时在运行时分派，
+// 为具体的 mapper 时寄存器写入直接调用并内联，实例化见 cpu.cpp 与 bus.cpp
+template <typename Mapper>
+class basic_bus {
   public:
-    bus() : cpu_{*this}, ppu_{*this} {
+    explicit basic_bus(dispatch_mode mode = dispatch_mode::table) : cpu_{*this, mode} {
+        ppu_.connect(nullptr, vram_.data());
+        map_pages();
+        start_frames();
     }
+    basic_bus(const basic_bus &) = delete;
 
   public:
-    auto cpu_bus_write(uint16_t addr, uint8_t data) -> void;
-    auto cpu_bus_read(uint16_t addr) -> uint8_t;
+    // 普通内存只需要查表和一次访存，io 页交给处理函数
+    auto cpu_bus_write(uint16_t addr, uint8_t data) -> void {
+        const auto &page = pages_[addr >> 8];
+        if (page.write) [[likely]] {
+            page.write[addr & 0xff] = data;
+        } else {
+            page.write_io(*this, addr, data);
+        }
+    }
+    auto cpu_bus_read(uint16_t addr) -> uint8_t {
+        const auto &page = pages_[addr >> 8];
+        if (page.read) [[likely]] {
+            return page.read[addr & 0xff];
+        }
+        return page.read_io(*this, addr);
+    }
+    auto trap_writes(uint16_t addr) -> void; // addr 所在的 ram 页缓存了代码，之后的写入需要通知 cpu
 
     auto ram() -> uint8_t * { return ram_.data(); }
     auto vram() -> uint8_t * { return vram_.data(); }
+    auto cpu() -> basic_cpu<basic_bus> & { return cpu_; }
+
+    // 以主时钟驱动整机：cpu 成批执行到下一个事件，事件在批次之间处理
+  public:
+    auto master_clock() -> uint64_t { return cpu_.clocks() * timing_->cpu_div; }
+    auto run_until(uint64_t time) -> void; // 执行到主时钟不早于 time
+    auto run_frame() -> void;              // 执行到下一次 vblank 开始
+    auto frame() -> uint64_t { return frame_; }
+    auto timing() -> const clock_timing & { return *timing_; }
+    auto set_ppu_sync(ppu_sync sync) -> void { ppu_sync_ = sync; }
+    auto set_ppu_render(ppu_render render) -> void { ppu_.set_render(render); } // 可以随时切换，下一行开始生效
+    auto frame_buffer() -> const uint8_t * { return ppu_.frame_buffer(); } // 256x240 的调色板颜色
 
     // 卡带管理
   public:
-    auto load_cartridget(std::shared_ptr<cartridge> cart) -> void { cart_ = cart; }
+    auto load_cartridget(std::shared_ptr<cartridge> cart) -> void; // mapper 与 Mapper 不符的卡带不响应寄存器写入
     auto cartridget() -> std::shared_ptr<cartridge> { return cart_; }
 
+    // 内存映射
+  private:
+    auto map_pages() -> void;
+    auto map_prg() -> void;
+    auto map_prg_ram() -> void;
+    static auto read_ppu(basic_bus &b, uint16_t addr) -> uint8_t;
+    static auto write_ppu(basic_bus &b, uint16_t addr, uint8_t data) -> void;
+    static auto read_io(basic_bus &b, uint16_t addr) -> uint8_t;
+    static auto write_io(basic_bus &b, uint16_t addr, uint8_t data) -> void;
+    static auto write_code(basic_bus &b, uint16_t addr, uint8_t data) -> void;
+    static auto write_prg(basic_bus &b, uint16_t addr, uint8_t data) -> void;
+    static auto write_save(basic_bus &b, uint16_t addr, uint8_t data) -> void;
+    static auto open_bus(basic_bus &b, uint16_t addr) -> uint8_t;
+    static auto ignore(basic_bus &b, uint16_t addr, uint8_t data) -> void;
+
+    // 调度
+  private:
+    auto start_frames() -> void;                    // 按卡带的制式从当前时刻开始新的一帧
+    auto schedule_frame() -> void;                  // 安排 ppu 下一次进入与离开 vblank 的事件
+    auto post_sprite0() -> void;                    // 按 ppu 的预测安排 sprite 0 命中
+    auto schedule_apu_frame(uint64_t time) -> void; // 按 $4017 安排 time 之后的帧计数器中断
+    auto schedule(event e, uint64_t time) -> void;  // 批量执行期间安排事件，必要时提前结束本批
+    auto run_batch(uint64_t time) -> void;
+    auto run_stepped(uint64_t time) -> void;
+    auto dispatch(event e, uint64_t time) -> void;
+    auto irq_line() -> bool;                        // mapper 与 apu 的中断输出
+    auto counts_scanlines() -> bool;
+
   private:
-    cpu cpu_;
+    basic_cpu<basic_bus> cpu_;
     ppu ppu_;
     std::shared_ptr<cartridge> cart_;
-    std::array<uint8_t, 2 * 1024> ram_{};  // 2KB Ram
-    std::array<uint8_t, 2 * 1024> vram_{}; // 2KB vRam
+    Mapper *mapper_{};                             // 卡带中的 mapper 状态
+    std::array<uint8_t, 2 * 1024> ram_{};          // 2KB Ram
+    std::array<uint8_t, 2 * 1024> vram_{};         // 2KB vRam
+    std::array<bus_page<basic_bus>, 256> pages_{}; // 页表
+
+    scheduler sched_;
+    const clock_timing *timing_{&ntsc_timing};
+    uint64_t frame_{};                      // vblank 次数
+    uint32_t scanline_{};                   // 下一个扫描线事件所在的行
+    uint8_t apu_frame_ctrl_{};              // $4017，第 6 位禁止中断，第 7 位为 5 步模式
+    bool apu_frame_irq_{};                  // 帧计数器中断标志，读取 $4015 时清除
+    ppu_sync ppu_sync_{ppu_sync::catch_up};
 };
+
+// 运行时按 mapper 分派的 bus，可以加载任何支持的卡带
+using bus = basic_bus<mapper>;
+using cpu = basic_cpu<bus>;
+
+// 所有实例化的 bus
+#define NES_FOR_EACH_BUS(X) X(basic_bus<mapper>) X(basic_bus<nrom>) X(basic_bus<uxrom>) X(basic_bus<cnrom>) \
+    X(basic_bus<axrom>) X(basic_bus<mmc1>) X(basic_bus<mmc3>)
+#define NES_EXTERN_BUS(B) extern template class B; extern template class basic_cpu<B>;
+NES_FOR_EACH_BUS(NES_EXTERN_BUS)
+#undef NES_EXTERN_BUS
@@ -1,54 +1,71 @@
 #include "cartridge.h"
-#include <string_view>
+#include <algorithm>
+#include <filesystem>
 
-cartridge::cartridge(const std::string &filename) {
-    ifs_.open(filename, std::ifstream::binary);
-    if (ifs_) {
-        valid_ = load();
-    }
-}
+cartridge::cartridge(const std::string &filename, save_mode save)
+    : cartridge(rom_image::load(filename),
+                save == save_mode::file ? std::filesystem::path{filename}.replace_extension(".sav").string() : std::string{}) {}
 
-auto cartridge::load() -> bool {
-    return load_header() && load_trainer() && load_rom() && load_mapper();
+cartridge::cartridge(std::shared_ptr<const rom_image> rom, const std::string &save_file) : rom_(std::move(rom)) {
+    valid_ = rom_ && load_mapper() && load_prg_ram(save_file);
 }
 
-auto cartridge::load_header() -> bool {
-    ifs_.read(reinterpret_cast<char *>(&header_), sizeof(header_));
-    ifs_.seekg(sizeof(header_), ifs_.cur);
-    return std::string_view(header_.identify, 4) == "NES\x1A";
-}
+auto cartridge::load_mapper() -> bool {
+    switch (mapper_id()) {
+        case 0:
+            mapper_ = nrom{};
+            break;
+        case 1:
+            mapper_ = mmc1{};
+            break;
+        case 2:
+            mapper_ = uxrom{};
+            break;
+        case 3:
+            mapper_ = cnrom{};
+            break;
+        case 4:
+            mapper_ = mmc3{};
+            break;
+        case 7:
+            mapper_ = axrom{};
+            break;
+        default:
+            return false;
+    }
 
-auto cartridge::load_trainer() -> bool {
-    if (header_.flag_6 & 0x04) {
-        trainer_.resize(512);
-        ifs_.read(reinterpret_cast<char *>(trainer_.data()), trainer_.size());
-        ifs_.seekg(512, ifs_.cur);
+    const auto &info = rom_->info();
+    if (info.chr_rom_size == 0) { // chr ram
+        chr_ram_.resize(std::max<size_t>(info.chr_ram_size, 0x2000));
+        banks_.chr_mem = chr_ram_;
+        chr_ram_tiles_.reset(chr_ram_);
+    } else {
+        banks_.chr_mem = rom_->chr_rom();
+        chr_rom_tiles_ = &rom_->chr_tiles();
     }
+    banks_.prg_rom = rom_->prg_rom();
+    banks_.chr_writable = info.chr_rom_size == 0;
+    banks_.mirror = info.mirror;
+    std::visit([this](auto &m) { m.reset(banks_); }, mapper_);
     return true;
 }
 
-auto cartridge::load_rom() -> bool {
-    if (((header_.flag_7 >> 2) & 0b11) != 1) { // 只支持 nes1.0
-        return false;
-    }
-
-    prg_rom_.resize(header_.prg_rom_size * 16 * 1024);
-    ifs_.read(reinterpret_cast<char *>(prg_rom_.data()), prg_rom_.size());
-    ifs_.seekg(prg_rom_.size(), ifs_.cur);
-
-    if (header_.chr_rom_size == 0) { // chr ram
-        chr_rom_.resize(8192);
+// 头部中没有 prg ram 的卡带也分配 8KB，0x6000 ~ 0x7fff 总是可以读写
+auto cartridge::load_prg_ram(const std::string &save_file) -> bool {
+    const auto &info = rom_->info();
+    const auto size = std::max<size_t>(info.prg_ram_size + info.prg_nvram_size, 0x2000);
+    if (info.battery && !save_file.empty()) {
+        prg_ram_ = std::make_unique<save_ram>(save_file, size);
     } else {
-        chr_rom_.resize(header_.chr_rom_size * 8 * 1024);
+        prg_ram_ = std::make_unique<save_ram>(size);
     }
-    ifs_.read(reinterpret_cast<char *>(chr_rom_.size()), chr_rom_.size());
     return true;
 }
 
-auto cartridge::load_mapper() -> bool {
-    switch ((header_.flag_6 >> 4) | ((header_.flag_7 >> 4) << 4)) {
-        // todo))
-    }
+auto cartridge::mapper_write(uint16_t addr, uint8_t data) -> void {
+    std::visit([&](auto &m) { m.write(banks_, addr, data); }, mapper_);
+}
 
-    return 0;
+auto cartridge::scanline() -> void {
+    std::visit([this](auto &m) { m.scanline(banks_); }, mapper_);
 }
\ No newline at end of file
@@ -1,43 +1,74 @@
 #pragma once
+#include "chr_cache.h"
+#include "mapper.h"
+#include "rom_image.h"
+#include "save_ram.h"
 #include <cstdint>
-#include <fstream>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
-// 卡带头部
-struct cart_header {
-    char identify[4];
-    uint8_t prg_rom_size;
-    uint8_t chr_rom_size;
-    uint8_t flag_6;
-    uint8_t flag_7;
-    uint8_t prg_ram_size;
-    uint8_t unused[7];
+// 有电池的卡带的 prg ram 是否保存到文件
+enum class save_mode {
+    file,   // 保存到 rom 旁边的 .sav 文件，文件已被其他实例打开时退回 memory（见 save_ram）
+    memory, // 只在内存中，用于不需要保存的批量运行
 };
-static_assert(sizeof(cart_header) == 16);
 
+// 一个模拟器实例的卡带，只读的 rom 在实例间共享，每个实例只持有自己的 ram 与 mapper 寄存器
 class cartridge {
   public:
-    cartridge(const std::string &filename);
+    cartridge(const std::string &filename, save_mode save = save_mode::file);
+    cartridge(std::shared_ptr<const rom_image> rom, const std::string &save_file = {}); // save_file 为空时只在内存中
+    cartridge(const cartridge &) = delete; // banks_ 中的窗口指向本实例的 chr_ram_
+    auto operator=(const cartridge &) -> cartridge & = delete;
 
     auto valid() -> bool { return valid_; }
+    auto rom() -> const std::shared_ptr<const rom_image> & { return rom_; }
+    auto header() -> const cart_header & { return rom_->header(); }
+    auto info() -> const rom_info & { return rom_->info(); }
+    auto mapper_id() -> int { return rom_->mapper_id(); }
+    auto trainer() -> std::span<const uint8_t> { return rom_->trainer(); }
+    auto prg_rom() -> std::span<const uint8_t> { return rom_->prg_rom(); }
+    auto chr_rom() -> std::span<const uint8_t> { return rom_->chr_rom(); } // chr ram 的卡带为空
+    auto prg_ram() -> save_ram & { return *prg_ram_; }                      // 0x6000 ~ 0x7fff，至少 8KB
+
+    // mapper
+  public:
+    auto prg_bank(int slot) -> const uint8_t * { return banks_.prg[slot]; } // 0x8000 起第 slot 个 8KB 窗口
+    auto chr_read(uint16_t addr) -> uint8_t { return banks_.chr[addr >> 10][addr & 0x3ff]; }
+    auto chr_write(uint16_t addr, uint8_t data) -> void {
+        if (banks_.chr_writable) { // 窗口指向 chr_ram_，换算成偏移后写入
+            const auto offset = banks_.chr[addr >> 10] - chr_ram_.data() + (addr & 0x3ff);
+            chr_ram_[offset] = data;
+            chr_ram_tiles_.mark_dirty(offset);
+        }
+    }
+    // addr 所在图块行解码后的 8 个像素，addr 为这一行低位平面的地址
+    auto chr_row(uint16_t addr, bool flip = false) -> const uint8_t * {
+        const auto offset = banks_.chr[addr >> 10] - banks_.chr_mem.data() + (addr & 0x3ff);
+        return banks_.chr_writable ? chr_ram_tiles_.row(offset, flip) : chr_rom_tiles_->row(offset, flip);
+    }
+    auto mirror() -> mirroring { return banks_.mirror; }
+    auto irq() -> bool { return banks_.irq; }
+    auto banks() -> mapper_banks & { return banks_; }
+    auto mapper_state() -> mapper & { return mapper_; }
+    auto mapper_write(uint16_t addr, uint8_t data) -> void; // 写入 0x8000 ~ 0xffff 的 mapper 寄存器
+    auto scanline() -> void;                                // 扫描线结束，mmc3 的中断计数
 
     // 加载卡带
   private:
-    auto load() -> bool;
-    auto load_header() -> bool;
-    auto load_trainer() -> bool;
-    auto load_rom() -> bool;
     auto load_mapper() -> bool;
+    auto load_prg_ram(const std::string &save_file) -> bool;
 
-    // 卡带内部存储
+    // 实例自己的可变状态
   private:
-    cart_header header_;
-    std::vector<uint8_t> trainer_;
-    std::vector<uint8_t> prg_rom_;
-    std::vector<uint8_t> chr_rom_;
-
-  private:
-    std::ifstream ifs_;
+    std::shared_ptr<const rom_image> rom_;
+    std::vector<uint8_t> chr_ram_;
+    chr_cache chr_ram_tiles_;          // 解码后的 chr ram
+    const chr_cache *chr_rom_tiles_{}; // rom_ 中共享的解码后的 chr rom
+    std::unique_ptr<save_ram> prg_ram_;
+    mapper_banks banks_;
+    mapper mapper_;
     bool valid_{};
-};
\ No newline at end of file
+};
@@ -0,0 +1,28 @@
+#include "chr_cache.h"
+
+auto chr_cache::reset(std::span<const uint8_t> chr) -> void {
+    chr_ = chr;
+    const auto count = chr.size() / tile_size;
+    tiles_.assign(count, {});
+    dirty_.assign((count + 63) / 64, 0);
+    for (auto tile = size_t{}; tile < count; ++tile) {
+        decode(tile);
+    }
+}
+
+// 低位平面在前 8 个字节，高位平面在后 8 个字节，每字节最高位是最左边的像素
+auto chr_cache::decode(size_t tile) -> void {
+    const auto *src = chr_.data() + tile * tile_size;
+    auto &dst = tiles_[tile];
+    for (auto y = 0; y < 8; ++y) {
+        const auto lo = src[y];
+        const auto hi = src[y + 8];
+        for (auto x = 0; x < 8; ++x) {
+            const auto bit = 7 - x;
+            const auto pixel = static_cast<uint8_t>(((lo >> bit) & 1) | (((hi >> bit) & 1) << 1));
+            dst.pixels[0][y * 8 + x] = pixel;
+            dst.pixels[1][y * 8 + 7 - x] = pixel;
+        }
+    }
+    dirty_[tile / 64] &= ~(uint64_t{1} << (tile % 64));
+}
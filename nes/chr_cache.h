@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// 解码后的 chr 图块：每个 16 字节的图块展开为 64 个 0 ~ 3 的像素，另存一份水平翻转供 sprite 使用，
+// 绘制时每行直接复制 8 个字节。全部图块在 reset 时解码，切换 bank 只改变窗口，不需要重新解码。
+// chr rom 的解码结果只读，由 rom_image 持有并在实例间共享；chr ram 每个实例一份，
+// 写入时在位图中标记所在的图块，下次读取时重新解码
+class chr_cache {
+  public:
+    static constexpr auto tile_size = 16; // chr 中一个图块的字节数
+
+    auto reset(std::span<const uint8_t> chr) -> void; // chr 为卡带的全部 chr rom 或 chr ram
+
+    // offset 为某一行低位平面在 chr 中的偏移，返回这一行的 8 个像素。
+    // const 版本不检查脏图块，只用于不会被写入的 chr rom
+    auto row(size_t offset, bool flip) const -> const uint8_t * {
+        return tiles_[offset / tile_size].pixels[flip] + (offset & 0x7) * 8;
+    }
+    auto row(size_t offset, bool flip) -> const uint8_t * {
+        const auto tile = offset / tile_size;
+        if (dirty_[tile / 64] & (uint64_t{1} << (tile % 64))) {
+            decode(tile);
+        }
+        return std::as_const(*this).row(offset, flip);
+    }
+    auto mark_dirty(size_t offset) -> void {
+        const auto tile = offset / tile_size;
+        dirty_[tile / 64] |= uint64_t{1} << (tile % 64);
+    }
+
+  private:
+    struct decoded_tile {
+        uint8_t pixels[2][64]; // 原样与水平翻转，按行存放
+    };
+
+    auto decode(size_t tile) -> void;
+
+  private:
+    std::span<const uint8_t> chr_;
+    std::vector<decoded_tile> tiles_;
+    std::vector<uint64_t> dirty_; // 每个图块一位
+};
@@ -0,0 +1,27 @@
+#include "console.h"
+
+namespace {
+
+// 卡带的 mapper 状态保存在 std::variant 中，下标即对应的 mapper 类型
+template <std::size_t I = 0>
+auto make_console_at(std::shared_ptr<cartridge> &cart, dispatch_mode mode) -> console {
+    if constexpr (I < std::variant_size_v<mapper>) {
+        if (cart->mapper_state().index() != I) {
+            return make_console_at<I + 1>(cart, mode);
+        }
+        auto b = std::make_unique<basic_bus<std::variant_alternative_t<I, mapper>>>(mode);
+        b->load_cartridget(cart);
+        return b;
+    } else {
+        return {};
+    }
+}
+
+} // namespace
+
+auto make_console(std::shared_ptr<cartridge> cart, dispatch_mode mode) -> console {
+    if (!cart || !cart->valid()) {
+        return {};
+    }
+    return make_console_at(cart, mode);
+}
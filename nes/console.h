@@ -0,0 +1,17 @@
+#pragma once
+#include "bus.h"
+#include <memory>
+#include <variant>
+
+// 按卡带的 mapper 实例化的主机，每种 mapper 一个 bus 与 cpu 的实例，
+// 选择只在加载时进行一次，之后的执行不再经过 mapper 分派
+using console = std::variant<std::monostate,
+                             std::unique_ptr<basic_bus<nrom>>,
+                             std::unique_ptr<basic_bus<uxrom>>,
+                             std::unique_ptr<basic_bus<cnrom>>,
+                             std::unique_ptr<basic_bus<axrom>>,
+                             std::unique_ptr<basic_bus<mmc1>>,
+                             std::unique_ptr<basic_bus<mmc3>>>;
+
+// 卡带无效时返回 std::monostate，mode 为 cpu 的执行方式
+auto make_console(std::shared_ptr<cartridge> cart, dispatch_mode mode = dispatch_mode::table) -> console;
@@ -1,37 +1,467 @@
 #include "bus.h"
+#include "cpu_bus.h"
+#include <algorithm>
 #include <format>
+#include <string_view>
 #include <utility>
 
-auto cpu::read(uint16_t addr) -> uint8_t {
+template <typename Bus>
+auto basic_cpu<Bus>::read(uint16_t addr) -> uint8_t {
+    if (lockstep_ != lockstep::off) [[unlikely]] {
+        return lockstep_read(addr);
+    }
     return bus_.cpu_bus_read(addr);
 }
 
-auto cpu::write(uint16_t addr, uint8_t data) -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::write(uint16_t addr, uint8_t data) -> void {
+    if (lockstep_ != lockstep::off) [[unlikely]] {
+        lockstep_write(addr, data);
+        return;
+    }
     bus_.cpu_bus_write(addr, data);
 }
 
-auto cpu::next_clock() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::next_clock() -> void {
     if (cycles_ == 0) {
-        opcode_ = next_pc();
-        cycles_ = inst_table[opcode_].cycles;
-        (this->*inst_table[opcode_].mod)();
-        (this->*inst_table[opcode_].opt)();
+        step();
     }
     --cycles_;
+    ++clocks_;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::next_inst() -> void {
+    clocks_ += cycles_;
+    clocks_ += step();
+    cycles_ = 0;
 }
 
-auto cpu::next_inst() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::step() -> uint8_t {
+    if (mode_ != dispatch_mode::table) {
+        if (const auto d = decoded(r_pc_)) {
+            opcode_ = d->opcode;
+            cycles_ = d->cycles;
+            r_pc_ += d->len;
+            d->exec(*this, d->operand);
+            return cycles_;
+        }
+    }
     opcode_ = next_pc();
-    (this->*inst_table[opcode_].mod)();
-    (this->*inst_table[opcode_].opt)();
+    const auto &inst = inst_table[opcode_];
+    cycles_ = inst.cycles;
+    inst.exec(*this);
+    return cycles_;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::run_cycles(uint32_t n) -> uint32_t {
+    return run_to(clocks_ + n);
+}
+
+// 未执行完的指令周期计入本次预算。批量执行期间 clocks_ 为当前指令开始的时刻，
+// io 处理函数可以据此追赶其他部件，也可以通过 limit_deadline 提前结束本次执行
+template <typename Bus>
+auto basic_cpu<Bus>::run_to(uint64_t deadline) -> uint32_t {
+    clocks_ += cycles_;
+    cycles_ = 0;
+    deadline_ = deadline;
+    idle_seen_ = false; // 两次调用之间可能发生了中断或外部修改
+    if (clocks_ < deadline_) {
+        if (mode_ == dispatch_mode::threaded) {
+            run_threaded();
+        } else if (mode_ == dispatch_mode::block || mode_ == dispatch_mode::checked) {
+            run_blocks();
+        } else if (mode_ == dispatch_mode::aot) {
+            run_aot();
+        } else {
+            do {
+                const auto pc = r_pc_;
+                clocks_ += step();
+                if (r_pc_ <= pc) [[unlikely]] {
+                    skip_idle();
+                }
+            } while (clocks_ < deadline_);
+            cycles_ = 0;
+        }
+    }
+    return clocks_ > deadline ? clocks_ - deadline : 0;
+}
+
+// 只翻译 prg rom 所在的 0x8000 ~ 0xffff，ram 中可能被自修改的代码交给解释器，
+// 块内逐条累加基本周期，分支与跨页的额外周期在块结束时计入
+template <typename Bus>
+auto basic_cpu<Bus>::run_blocks() -> void {
+    do {
+        if (r_pc_ < 0x8000) {
+            clocks_ += step();
+            continue;
+        }
+        const auto &blk = translate(r_pc_);
+        if (mode_ == dispatch_mode::checked) {
+            run_checked(blk);
+        } else {
+            run_block(blk);
+        }
+        if (r_pc_ <= blk.last) {
+            skip_idle();
+        }
+    } while (clocks_ < deadline_);
+    cycles_ = 0;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::run_block(const code_block &blk) -> uint32_t {
+    const auto ops = blk.ops.data();
+    const auto n = static_cast<uint32_t>(blk.ops.size());
+    cycles_ = 0;
+    code_dirty_ = false;
+    auto i = 0u;
+    while (i < n) {
+        r_pc_ += ops[i].len;
+        ops[i].exec(*this, ops[i].operand);
+        clocks_ += ops[i].cycles;
+        ++i;
+        if (code_dirty_) [[unlikely]] {
+            break; // 块内写入了代码区域（如切换 bank），剩余指令需要重新翻译
+        }
+    }
+    clocks_ += cycles_;
+    return i;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::translate(uint16_t addr) -> const code_block & {
+    constexpr auto max_block_ops = 64;
+    if (block_idx_.empty() || blocks_.size() >= 0xffff) {
+        blocks_.clear();
+        block_idx_.assign(0x8000, 0);
+    }
+    if (const auto idx = block_idx_[addr - 0x8000]; idx != 0) {
+        return blocks_[idx - 1];
+    }
+
+    auto blk = code_block{.start = addr, .last = addr, .valid = true};
+    auto pc = uint32_t{addr};
+    while (blk.ops.size() < max_block_ops) {
+        const auto &d = *decoded(pc);
+        if (!blk.ops.empty() && pc + d.len > 0x10000) {
+            break;
+        }
+        blk.ops.push_back(d);
+        blk.cycles += d.cycles;
+        blk.last = pc + d.len - 1;
+        pc += d.len;
+        if (inst_infos[d.opcode].ends_block) {
+            break;
+        }
+    }
+    blocks_.push_back(std::move(blk));
+    block_idx_[addr - 0x8000] = blocks_.size();
+    return blocks_.back();
+}
+
+// lockstep：先执行翻译的块并记录全部数据访存，再从块开始时的状态用查表解释器逐条执行同样多的指令。
+// 解释器的读取回放记录的值、写入只与记录比较，不再到达 bus，io 的副作用只发生一次。
+// 比较寄存器、标志、周期数与访存序列，不一致时以解释器的寄存器为准，内存保留块执行的结果。
+// 访存序列不一致时解释器读不到记录的值，停止回放并保留块执行的结果
+template <typename Bus>
+auto basic_cpu<Bus>::run_checked(const code_block &blk) -> void {
+    const auto before = save_state();
+    const auto start = clocks_;
+    const auto stalled = stalled_;
+    accesses_.clear();
+    lockstep_ = lockstep::record;
+    const auto n = run_block(blk);
+    lockstep_ = lockstep::off;
+    if (code_dirty_) {
+        return; // 块内切换了 bank 或修改了代码，解释器重新取指会得到不同的指令
+    }
+    const auto after = save_state();
+    const auto cycles = clocks_ - start - (stalled_ - stalled);
+
+    load_state(before);
+    const auto mode = mode_;
+    mode_ = dispatch_mode::table;
+    lockstep_ = lockstep::replay;
+    replay_pos_ = 0;
+    replay_diverged_ = false;
+    auto expect_cycles = uint64_t{};
+    for (auto i = 0u; i < n && !replay_diverged_; ++i) {
+        expect_cycles += step();
+    }
+    lockstep_ = lockstep::off;
+    mode_ = mode;
+    cycles_ = 0;
+    const auto expect = save_state();
+
+    if (replay_diverged_) {
+        ++check_errors_;
+        invalidate_code(blk.start, blk.last);
+        load_state(after);
+    } else if (replay_pos_ != accesses_.size() || expect != after || expect_cycles != cycles) {
+        ++check_errors_;
+        invalidate_code(blk.start, blk.last);
+        clocks_ += expect_cycles - cycles;
+    } else {
+        load_state(after);
+    }
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::lockstep_read(uint16_t addr) -> uint8_t {
+    if (lockstep_ == lockstep::record) {
+        const auto data = bus_.cpu_bus_read(addr);
+        accesses_.push_back({addr, data, false});
+        return data;
+    }
+    if (replay_pos_ < accesses_.size() && accesses_[replay_pos_] == mem_access{addr, accesses_[replay_pos_].data, false}) {
+        return accesses_[replay_pos_++].data;
+    }
+    replay_diverged_ = true;
+    return 0;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::lockstep_write(uint16_t addr, uint8_t data) -> void {
+    if (lockstep_ == lockstep::record) {
+        accesses_.push_back({addr, data, true});
+        bus_.cpu_bus_write(addr, data);
+        return;
+    }
+    if (replay_pos_ < accesses_.size() && accesses_[replay_pos_] == mem_access{addr, data, true}) {
+        ++replay_pos_;
+    } else {
+        replay_diverged_ = true;
+    }
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::save_state() -> cpu_state {
+    const auto s = stat();
+    return {r_a_, r_x_, r_y_, r_sp_, *reinterpret_cast<const uint8_t *>(&s), r_pc_};
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::load_state(const cpu_state &s) -> void {
+    r_a_ = s.a;
+    r_x_ = s.x;
+    r_y_ = s.y;
+    r_sp_ = s.sp;
+    *reinterpret_cast<uint8_t *>(&r_stat_) = s.stat;
+    nz_lazy_ = false;
+    r_pc_ = s.pc;
+}
+
+// 预编译代码无法覆盖间接跳转的目标和 ram 中的代码，这些地址回退到解释器
+template <typename Bus>
+auto basic_cpu<Bus>::run_aot() -> void {
+    do {
+        const auto pc = r_pc_;
+        if (!aot_(*this)) {
+            clocks_ += step();
+        }
+        if (r_pc_ <= pc) {
+            skip_idle();
+        }
+    } while (clocks_ < deadline_);
+    cycles_ = 0;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::load_aot(aot_entry entry) -> void {
+    aot_ = entry;
+    mode_ = entry ? dispatch_mode::aot : dispatch_mode::table;
+}
+
+// 入口处的寄存器与标志和上一次迭代相同、期间没有写内存，之后每次迭代都完全相同，
+// 直到截止时间的事件（vblank、irq 等）改变读到的值为止，可以直接跳到截止时间
+template <typename Bus>
+auto basic_cpu<Bus>::skip_idle() -> void {
+    if (!idle_known_ || idle_pc_ != r_pc_) {
+        idle_pc_ = r_pc_;
+        idle_period_ = idle_verdict(r_pc_);
+        idle_known_ = true;
+        idle_seen_ = false;
+    }
+    if (idle_period_ == 0) {
+        return;
+    }
+    const auto s = stat();
+    const auto regs = r_a_ | (r_x_ << 8) | (r_y_ << 16) | (r_sp_ << 24) |
+                      (uint64_t{*reinterpret_cast<const uint8_t *>(&s)} << 32);
+    // 周期数不等说明中途离开过循环，或者走了循环内的其他路径
+    // 只跳过整数次迭代，最后一次迭代照常执行，停下的位置与逐条执行相同
+    if (idle_seen_ && regs == idle_regs_ && clocks_ - idle_clocks_ == idle_period_ && clocks_ < deadline_) {
+        const auto skipped = (deadline_ - clocks_ - 1) / idle_period_ * idle_period_;
+        skipped_cycles_ += skipped;
+        clocks_ += skipped;
+    }
+    idle_seen_ = true;
+    idle_regs_ = regs;
+    idle_clocks_ = clocks_;
+}
+
+// ram 中的代码可能被改写而不通知 cpu，每次重新分析；prg rom 只在 bank 切换时改变，由 invalidate_code 清除
+template <typename Bus>
+auto basic_cpu<Bus>::idle_verdict(uint16_t head) -> uint32_t {
+    if (head < 0x8000) {
+        return idle_loop_cycles(head);
+    }
+    if (const auto it = idle_verdicts_.find(head); it != idle_verdicts_.end()) {
+        return it->second;
+    }
+    return idle_verdicts_[head] = idle_loop_cycles(head);
+}
+
+// 只接受由分支或 jmp 跳回 head 的短循环，循环体中的指令都是 idle_safe 的，
+// 并且只读 ram、prg 或 $2002，其他 io 寄存器的读取有副作用
+template <typename Bus>
+auto basic_cpu<Bus>::idle_loop_cycles(uint16_t head) -> uint32_t {
+    constexpr auto max_loop_ops = 8;
+    const auto readable = [](uint32_t lo, uint32_t hi) {
+        return hi < 0x2000 || lo >= 0x6000 || (lo == hi && (lo & 0xe007) == 0x2002);
+    };
+    auto pc = uint32_t{head};
+    auto cycles = uint32_t{};
+    for (auto i = 0; i < max_loop_ops && pc <= 0xfffd; ++i) {
+        // 分析本身也不能读有副作用的地址，先检查操作码，知道长度后再检查操作数
+        if (!readable(pc, pc)) {
+            return 0;
+        }
+        const auto opcode = read(pc);
+        const auto &inst = inst_table[opcode];
+        if (!inst_infos[opcode].idle_safe || !readable(pc, pc + inst.len - 1)) {
+            return 0;
+        }
+        const auto lo = inst.len > 1 ? read(pc + 1) : uint8_t{};
+        const auto abs = lo | (inst.len > 2 ? read(pc + 2) << 8 : 0);
+        switch (inst.mod) {
+            case addr_mode::ABS:
+                if (opcode != 0x4c && !readable(abs, abs)) {
+                    return 0;
+                }
+                break;
+            case addr_mode::ABSX:
+            case addr_mode::ABSY:
+                if (!readable(abs, abs + 0xff)) {
+                    return 0;
+                }
+                break;
+            case addr_mode::INDX:
+            case addr_mode::INDY:
+                return 0;
+            default:
+                break;
+        }
+        cycles += inst.cycles;
+        if (opcode == 0x4c) {
+            return abs == head ? cycles : 0;
+        }
+        if (inst.mod == addr_mode::REL) {
+            const auto target = (pc + 2 + static_cast<int8_t>(lo)) & 0xffff;
+            if (target == head) {
+                return cycles + 1; // 分支成立多一个周期
+            }
+            if (target <= pc) {
+                return 0;
+            }
+        }
+        pc += inst.len;
+    }
+    return 0;
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::decode_at(uint16_t pc) -> decoded_inst {
+    const auto opcode = read(pc);
+    const auto &inst = inst_table[opcode];
+    auto operand = uint16_t{};
+    if (inst.mod == addr_mode::IMM) {
+        operand = pc + 1;
+    } else if (inst.len == 2) {
+        operand = read(pc + 1);
+    } else if (inst.len == 3) {
+        operand = read(pc + 1) | (read(pc + 2) << 8);
+    }
+    return {decoded_table[opcode], operand, opcode, inst.len, inst.cycles};
+}
+
+// 只缓存 prg rom 与内部 ram 中的代码，其他区域的读取可能有副作用；bus 不能通知代码修改时不缓存
+template <typename Bus>
+auto basic_cpu<Bus>::decoded(uint16_t pc) -> const decoded_inst * {
+    if constexpr (!code_watching_bus<Bus>) {
+        return nullptr;
+    } else {
+        decoded_inst *d{};
+        if (pc >= 0x8000) {
+            if (rom_cache_.empty()) {
+                rom_cache_.resize(0x8000);
+            }
+            d = &rom_cache_[pc - 0x8000];
+        } else if (pc < 0x2000) {
+            if (ram_cache_.empty()) {
+                ram_cache_.resize(0x800);
+            }
+            d = &ram_cache_[pc & 0x7ff];
+        } else {
+            return nullptr;
+        }
+        if (!d->exec) {
+            *d = decode_at(pc);
+            if (pc < 0x2000) {
+                for (const auto addr : {pc, static_cast<uint16_t>(pc + d->len - 1)}) {
+                    const auto bit = 1u << ((addr & 0x7ff) >> 8);
+                    if (!(ram_code_pages_ & bit)) {
+                        ram_code_pages_ |= bit;
+                        bus_.trap_writes(addr); // 之后写入这一页时使缓存失效
+                    }
+                }
+            }
+        }
+        return d;
+    }
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::invalidate_code(uint16_t lo, uint16_t hi) -> void {
+    // 指令最长 3 字节，从 lo - 2 开始的指令都可能包含被修改的字节
+    const auto from = lo < 2 ? 0 : lo - 2;
+    if (lo < 0x2000 && !ram_cache_.empty()) {
+        for (auto addr = from; addr <= hi && addr < 0x2000; ++addr) {
+            ram_cache_[addr & 0x7ff].exec = nullptr;
+        }
+    }
+    idle_known_ = false;
+    if (hi < 0x8000) {
+        return;
+    }
+    // 循环体最多 8 条指令，从 lo - 23 开始的循环都可能包含被修改的字节
+    std::erase_if(idle_verdicts_, [&](const auto &v) { return v.first + 23 >= lo && v.first <= hi; });
+    if (!rom_cache_.empty()) {
+        for (auto addr = std::max(from, 0x8000); addr <= hi; ++addr) {
+            rom_cache_[addr - 0x8000].exec = nullptr;
+        }
+    }
+    for (auto &blk : blocks_) {
+        if (blk.valid && blk.start <= hi && blk.last >= lo) {
+            blk.valid = false;
+            block_idx_[blk.start - 0x8000] = 0;
+            code_dirty_ = true;
+        }
+    }
 }
 
-auto cpu::reset() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::reset() -> void {
     r_a_ = 0;
     r_x_ = 0;
     r_y_ = 0;
     r_sp_ = 0xfd;
     *reinterpret_cast<uint8_t *>(&r_stat_) = 0;
+    nz_lazy_ = false;
     r_pc_ = (read(0xfffd) << 8) | read(0xfffc);
     addr_ = 0;
     off_ = 0;
@@ -39,7 +469,8 @@ auto cpu::reset() -> void {
     cycles_ = 0;
 }
 
-auto cpu::irq() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::irq() -> void {
     if (r_stat_.I == 0) {
         push_pc();
         push_stat();
@@ -50,7 +481,8 @@ auto cpu::irq() -> void {
     }
 }
 
-auto cpu::nmi() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::nmi() -> void {
     push_pc();
     push_stat();
     r_stat_.B = 0;
@@ -59,591 +491,840 @@ auto cpu::nmi() -> void {
     cycles_ = 8;
 }
 
-auto cpu::fetch() -> uint8_t {
-    if (inst_table[opcode_].mod == &cpu::ACC) {
+template <typename Bus>
+auto basic_cpu<Bus>::fetch() -> uint8_t {
+    return fetched_ = read(addr_);
+}
+
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::address() -> void {
+    if constexpr (Mod == addr_mode::ABS) {
+        ABS();
+    } else if constexpr (Mod == addr_mode::ABSX) {
+        ABSX();
+    } else if constexpr (Mod == addr_mode::ABSY) {
+        ABSY();
+    } else if constexpr (Mod == addr_mode::ACC) {
+        ACC();
+    } else if constexpr (Mod == addr_mode::IMM) {
+        IMM();
+    } else if constexpr (Mod == addr_mode::IMP) {
+        IMP();
+    } else if constexpr (Mod == addr_mode::IND) {
+        IND();
+    } else if constexpr (Mod == addr_mode::INDX) {
+        INDX();
+    } else if constexpr (Mod == addr_mode::INDY) {
+        INDY();
+    } else if constexpr (Mod == addr_mode::REL) {
+        REL();
+    } else if constexpr (Mod == addr_mode::ZP) {
+        ZP();
+    } else if constexpr (Mod == addr_mode::ZPX) {
+        ZPX();
+    } else if constexpr (Mod == addr_mode::ZPY) {
+        ZPY();
+    }
+}
+
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::operand() -> uint8_t {
+    if constexpr (Mod == addr_mode::ACC) {
         return r_a_;
+    } else {
+        return fetch();
     }
-    return fetched_ = read(addr_);
 }
 
-auto cpu::branch_if(bool cond) -> void {
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::store(uint8_t data) -> void {
+    if constexpr (Mod == addr_mode::ACC) {
+        r_a_ = data;
+    } else {
+        write(addr_, data);
+    }
+}
+
+// 寻址与操作在编译期融合，每条指令只有一次间接调用
+template <typename Bus>
+template <typename basic_cpu<Bus>::opt_type Opt, addr_mode Mod>
+auto basic_cpu<Bus>::exec(basic_cpu &c) -> void {
+    c.address<Mod>();
+    (c.*Opt)();
+}
+
+// 与 address<Mod>() 结果相同，但操作数字节已在译码时读出
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::address_decoded(uint16_t operand) -> void {
+    if constexpr (Mod == addr_mode::ABS || Mod == addr_mode::IMM || Mod == addr_mode::ZP) {
+        addr_ = operand;
+    } else if constexpr (Mod == addr_mode::ABSX) {
+        addr_ = operand + r_x_;
+    } else if constexpr (Mod == addr_mode::ABSY) {
+        addr_ = operand + r_y_;
+    } else if constexpr (Mod == addr_mode::IND) {
+        addr_ = read(operand) | (read(operand + 1) << 8);
+    } else if constexpr (Mod == addr_mode::INDX) {
+        addr_ = (operand + r_x_) & 0xff;
+        addr_ = read(addr_) | (read((addr_ + 1) & 0xff) << 8);
+    } else if constexpr (Mod == addr_mode::INDY) {
+        addr_ = operand;
+        addr_ = (read(addr_) | (read((addr_ + 1) & 0xff) << 8)) + r_y_;
+    } else if constexpr (Mod == addr_mode::REL) {
+        off_ = static_cast<int8_t>(operand);
+    } else if constexpr (Mod == addr_mode::ZPX) {
+        addr_ = (operand + r_x_) & 0xff;
+    } else if constexpr (Mod == addr_mode::ZPY) {
+        addr_ = (operand + r_y_) & 0xff;
+    }
+}
+
+template <typename Bus>
+template <typename basic_cpu<Bus>::opt_type Opt, addr_mode Mod>
+auto basic_cpu<Bus>::exec_decoded(basic_cpu &c, uint16_t operand) -> void {
+    c.address_decoded<Mod>(operand);
+    (c.*Opt)();
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::branch_if(bool cond) -> void {
     if (cond) {
         cycles_ += 1;
         r_pc_ += off_;
     }
 }
 
-auto cpu::push_pc() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::push_pc() -> void {
     stack_push((r_pc_ >> 8) & 0xff);
     stack_push(r_pc_ & 0xff);
 }
 
-auto cpu::ABSX() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::ABSX() -> void {
     auto lo = next_pc();
     auto hi = next_pc();
     addr_ = (lo | (hi << 8)) + r_x_;
 }
 
-auto cpu::ABSY() -> void {
-    auto lo = read(r_pc_++);
-    auto hi = read(r_pc_++);
+template <typename Bus>
+auto basic_cpu<Bus>::ABSY() -> void {
+    auto lo = next_pc();
+    auto hi = next_pc();
     addr_ = (lo | (hi << 8)) + r_y_;
 }
 
-auto cpu::IND() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::IND() -> void {
     addr_ = next_pc() | (next_pc() << 8);
     addr_ = read(addr_) | (read(addr_ + 1) << 8);
 }
 
-auto cpu::INDX() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::INDX() -> void {
     addr_ = (next_pc() + r_x_) & 0xff;
-    addr_ = read(addr_) | (read(addr_ + 1) << 8);
+    addr_ = read(addr_) | (read((addr_ + 1) & 0xff) << 8);
 }
 
-auto cpu::INDY() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::INDY() -> void {
     addr_ = next_pc();
-    addr_ = read(addr_) | (read(addr_ + 1) << 8) + r_y_;
+    addr_ = (read(addr_) | (read((addr_ + 1) & 0xff) << 8)) + r_y_;
 }
 
-auto cpu::ADC() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::ADC() -> void {
     const uint16_t tmp = static_cast<uint16_t>(r_a_) + fetch() + r_stat_.C;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.V = ~(static_cast<uint16_t>(r_a_) ^ fetched_) & ((r_a_ ^ tmp) & 0x80);
-    r_stat_.Z = r_a_ == 0;
-    r_stat_.C = tmp > 255;
+    r_stat_.V = (~(r_a_ ^ fetched_) & (r_a_ ^ tmp) & 0x80) != 0;
+    r_stat_.C = tmp > 0xff;
     r_a_ = tmp & 0xff;
+    set_nz(r_a_);
 }
 
-auto cpu::AND() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::AND() -> void {
     r_a_ &= fetch();
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
+    set_nz(r_a_);
 }
 
-auto cpu::ASL() -> void {
-    const uint16_t tmp = fetch() << 1;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = (tmp & 0xff) == 0;
-    r_stat_.C = tmp & 0xff00;
-    if (inst_table[opcode_].mod == &cpu::ACC) {
-        r_a_ = tmp & 0xff;
-    } else {
-        write(addr_, tmp & 0xff);
-    }
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::ASL() -> void {
+    const uint16_t tmp = operand<Mod>() << 1;
+    r_stat_.C = tmp > 0xff;
+    set_nz(tmp & 0xff);
+    store<Mod>(tmp & 0xff);
 }
 
-auto cpu::BIT() -> void {
-    r_stat_.N = (fetch() >> 7) & 0x1;
-    r_stat_.V = (fetched_ >> 6) & 0x1;
-    r_stat_.Z = (fetched_ & r_a_) == 0;
+template <typename Bus>
+auto basic_cpu<Bus>::BIT() -> void {
+    r_stat_.V = (fetch() >> 6) & 0x1;
+    set_nz_flags((fetched_ >> 7) & 0x1, (fetched_ & r_a_) == 0);
 }
 
-auto cpu::BRK() -> void {
-    stack_push(r_pc_);
-    r_pc_ = 0xfffe;
+template <typename Bus>
+auto basic_cpu<Bus>::BRK() -> void {
+    ++r_pc_; // brk 后有一个填充字节
+    push_pc();
     r_stat_.B = 1;
+    push_stat();
+    r_stat_.I = 1;
+    r_pc_ = read(0xfffe) | (read(0xffff) << 8);
 }
 
-auto cpu::CMP() -> void {
-    const uint16_t tmp = static_cast<uint16_t>(r_a_) - fetch();
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
+template <typename Bus>
+auto basic_cpu<Bus>::CMP() -> void {
+    const uint8_t tmp = r_a_ - fetch();
     r_stat_.C = r_a_ >= fetched_;
+    set_nz(tmp);
 }
 
-auto cpu::CPX() -> void {
-    const uint16_t tmp = static_cast<uint16_t>(r_x_) - fetch();
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
+template <typename Bus>
+auto basic_cpu<Bus>::CPX() -> void {
+    const uint8_t tmp = r_x_ - fetch();
     r_stat_.C = r_x_ >= fetched_;
+    set_nz(tmp);
 }
 
-auto cpu::CPY() -> void {
-    const uint16_t tmp = static_cast<uint16_t>(r_y_) - fetch();
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
+template <typename Bus>
+auto basic_cpu<Bus>::CPY() -> void {
+    const uint8_t tmp = r_y_ - fetch();
     r_stat_.C = r_y_ >= fetched_;
+    set_nz(tmp);
 }
 
-auto cpu::DEC() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::DEC() -> void {
     const uint8_t tmp = fetch() - 1;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
+    set_nz(tmp);
     write(addr_, tmp & 0xff);
 }
 
-auto cpu::DEX() -> void {
-    const uint8_t tmp = r_x_ - 1;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
-    write(addr_, tmp & 0xff);
+template <typename Bus>
+auto basic_cpu<Bus>::DEX() -> void {
+    r_x_ -= 1;
+    set_nz(r_x_);
 }
 
-auto cpu::DEY() -> void {
-    const uint8_t tmp = r_y_ - 1;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
-    write(addr_, tmp & 0xff);
+template <typename Bus>
+auto basic_cpu<Bus>::DEY() -> void {
+    r_y_ -= 1;
+    set_nz(r_y_);
 }
 
-auto cpu::EOR() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::EOR() -> void {
     r_a_ ^= fetch();
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
+    set_nz(r_a_);
 }
 
-auto cpu::INC() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::INC() -> void {
     const uint8_t tmp = fetch() + 1;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
+    set_nz(tmp);
     write(addr_, tmp);
 }
 
-auto cpu::INX() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::INX() -> void {
     r_x_ += 1;
-    r_stat_.N = r_x_ & 0x80;
-    r_stat_.Z = r_x_ == 0;
+    set_nz(r_x_);
 }
 
-auto cpu::INY() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::INY() -> void {
     r_y_ += 1;
-    r_stat_.N = r_y_ & 0x80;
-    r_stat_.Z = r_y_ == 0;
+    set_nz(r_y_);
 }
 
-auto cpu::JSR() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::JSR() -> void {
     push_pc();
     r_pc_ = addr_;
 }
 
-auto cpu::LDA() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::LDA() -> void {
     r_a_ = fetch();
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
+    set_nz(r_a_);
 }
 
-auto cpu::LDX() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::LDX() -> void {
     r_x_ = fetch();
-    r_stat_.N = r_x_ & 0x80;
-    r_stat_.Z = r_x_ == 0;
+    set_nz(r_x_);
 }
 
-auto cpu::LDY() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::LDY() -> void {
     r_y_ = fetch();
-    r_stat_.N = r_y_ & 0x80;
-    r_stat_.Z = r_y_ == 0;
+    set_nz(r_y_);
 }
 
-auto cpu::LSR() -> void {
-    uint16_t tmp = fetch();
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::LSR() -> void {
+    const uint8_t tmp = operand<Mod>();
     r_stat_.C = tmp & 0x1;
-    tmp >>= 1;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
-    if (inst_table[opcode_].mod == &cpu::ACC) {
-        r_a_ = tmp & 0xff;
-    } else {
-        write(addr_, tmp & 0xff);
-    }
+    set_nz(tmp >> 1);
+    store<Mod>(tmp >> 1);
 }
 
-auto cpu::ORA() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::ORA() -> void {
     r_a_ |= fetch();
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
+    set_nz(r_a_);
 }
 
-auto cpu::PLA() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::PLA() -> void {
     r_a_ = stack_pull();
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
+    set_nz(r_a_);
 }
 
-auto cpu::ROL() -> void {
-    const uint16_t tmp = (fetch() << 1) + r_stat_.C;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
-    r_stat_.C = tmp & 0xff00;
-    if (inst_table[opcode_].mod == &cpu::ACC) {
-        r_a_ = tmp;
-    } else {
-        write(addr_, tmp);
-    }
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::ROL() -> void {
+    const uint16_t tmp = (operand<Mod>() << 1) | r_stat_.C;
+    r_stat_.C = tmp > 0xff;
+    set_nz(tmp & 0xff);
+    store<Mod>(tmp & 0xff);
 }
 
-auto cpu::ROR() -> void {
-    const uint16_t tmp = (fetch() >> 1) | (r_stat_.C << 7);
-    r_stat_.N = tmp & 0x80;
-    r_stat_.Z = tmp == 0;
-    r_stat_.C = tmp & 0x1;
-    if (inst_table[opcode_].mod == &cpu::ACC) {
-        r_a_ = tmp;
-    } else {
-        write(addr_, tmp);
-    }
+template <typename Bus>
+template <addr_mode Mod>
+auto basic_cpu<Bus>::ROR() -> void {
+    const uint8_t val = operand<Mod>();
+    const uint8_t tmp = (val >> 1) | (r_stat_.C << 7);
+    r_stat_.C = val & 0x1;
+    set_nz(tmp);
+    store<Mod>(tmp);
 }
 
-auto cpu::RTI() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::RTI() -> void {
     pull_stat();
     r_stat_.B = ~r_stat_.B;
-    r_stat_.I = ~r_stat_.I;
     pull_pc();
 }
 
-auto cpu::SBC() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::SBC() -> void {
     const uint16_t val = fetch() ^ 0xff;
     const uint16_t tmp = r_a_ + val + r_stat_.C;
-    r_stat_.N = tmp & 0x80;
-    r_stat_.V = (tmp ^ r_a_) & ((tmp ^ val) & 0x80);
-    r_stat_.Z = (tmp & 0xff) == 0;
-    r_stat_.C = tmp & 0xff00;
+    r_stat_.V = ((tmp ^ r_a_) & (tmp ^ val) & 0x80) != 0;
+    r_stat_.C = tmp > 0xff;
     r_a_ = tmp & 0xff;
+    set_nz(r_a_);
 }
 
-auto cpu::TAX() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::TAX() -> void {
     r_x_ = r_a_;
-    r_stat_.N = r_x_ & 0x80;
-    r_stat_.Z = r_x_ == 0;
+    set_nz(r_x_);
 }
 
-auto cpu::TAY() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::TAY() -> void {
     r_y_ = r_a_;
-    r_stat_.N = r_y_ & 0x80;
-    r_stat_.Z = r_y_ == 0;
+    set_nz(r_y_);
 }
 
-auto cpu::TSX() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::TSX() -> void {
     r_x_ = r_sp_;
-    r_stat_.N = r_x_ & 0x80;
-    r_stat_.Z = r_x_ == 0;
+    set_nz(r_x_);
 }
 
-auto cpu::TXA() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::TXA() -> void {
     r_a_ = r_x_;
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
+    set_nz(r_a_);
 }
 
-auto cpu::TYA() -> void {
+template <typename Bus>
+auto basic_cpu<Bus>::TYA() -> void {
     r_a_ = r_y_;
-    r_stat_.N = r_a_ & 0x80;
-    r_stat_.Z = r_a_ == 0;
-}
-
-auto cpu::inst_len(const instruction &inst) -> int {
-    if (inst.mod == &cpu::ABS || inst.mod == &cpu::ABSX || inst.mod == &cpu::ABSY) {
-        return 3;
-    } else if (inst.mod == &cpu::ACC) {
-        return 1;
-    } else if (inst.mod == &cpu::IMM) {
-        return 2;
-    } else if (inst.mod == &cpu::IMP) {
-        return 1;
-    } else if (inst.mod == &cpu::IND) {
-        return 3;
-    } else if (inst.mod == &cpu::INDX || inst.mod == &cpu::INDY) {
-        return 2;
-    } else if (inst.mod == &cpu::REL) {
-        return 2;
-    } else if (inst.mod == &cpu::ZP || inst.mod == &cpu::ZPX || inst.mod == &cpu::ZPY) {
-        return 2;
+    set_nz(r_a_);
+}
+
+template <typename Bus>
+auto basic_cpu<Bus>::inst_len(uint8_t opcode) -> int {
+    return inst_table[opcode].len;
+}
+
+// 格式：指令名称 $地址 | #立即数 | $[$地址]
+template <typename Bus>
+auto basic_cpu<Bus>::inst_str(uint8_t *mem, uint16_t pc) -> std::string {
+    constexpr std::string_view mode_names[] = {"ABS", "ABSX", "ABSY", "ACC", "IMM", "IMP", "IND", "INDX", "INDY", "REL", "ZP", "ZPX", "ZPY"};
+    const auto &inst = inst_table[mem[pc]];
+    const auto name = inst_infos[mem[pc]].name;
+    const auto mode = mode_names[static_cast<int>(inst.mod)];
+    switch (inst.mod) {
+        case addr_mode::ABS:
+            return std::format("${:04x}: {} ${:04x} ({}) {}c\n", pc, name, (mem[pc + 1] | (mem[pc + 2] << 8)), mode, inst.cycles);
+        case addr_mode::ABSX:
+            return std::format("${:04x}: {} ${:04x}+x ({}) {}c\n", pc, name, (mem[pc + 1] | (mem[pc + 2] << 8)), mode, inst.cycles);
+        case addr_mode::ABSY:
+            return std::format("${:04x}: {} ${:04x}+y ({}) {}c\n", pc, name, (mem[pc + 1] | (mem[pc + 2] << 8)), mode, inst.cycles);
+        case addr_mode::ACC:
+        case addr_mode::IMP:
+            return std::format("${:04x}: {} ({}) {}c\n", pc, name, mode, inst.cycles);
+        case addr_mode::IMM:
+            return std::format("${:04x}: {} #{:02x} ({}) {}c\n", pc, name, mem[pc + 1], mode, inst.cycles);
+        case addr_mode::IND:
+            return std::format("${:04x}: {} $[${:04x}] ({}) {}c\n", pc, name, (mem[pc + 1] | (mem[pc + 2] << 8)), mode, inst.cycles);
+        case addr_mode::INDX:
+            return std::format("${:04x}: {} $[${:02x}+x] ({}) {}c\n", pc, name, mem[pc + 1], mode, inst.cycles);
+        case addr_mode::INDY:
+            return std::format("${:04x}: {} $[${:02x}]+y ({}) {}c\n", pc, name, mem[pc + 1], mode, inst.cycles);
+        case addr_mode::REL:
+        case addr_mode::ZP:
+            return std::format("${:04x}: {} ${:02x} ({}) {}c\n", pc, name, mem[pc + 1], mode, inst.cycles);
+        case addr_mode::ZPX:
+            return std::format("${:04x}: {} ${:02x}+x ({}) {}c\n", pc, name, mem[pc + 1], mode, inst.cycles);
+        case addr_mode::ZPY:
+            return std::format("${:04x}: {} ${:02x}+y ({}) {}c\n", pc, name, mem[pc + 1], mode, inst.cycles);
     }
     std::unreachable();
-    abort();
 }
 
-// 格式：指令名称 $地址 | #立即数 | $[$地址]
-auto cpu::inst_str(uint8_t *mem, uint16_t pc) -> std::string {
-    auto inst = inst_table[mem[pc]];
-    auto res = std::string{};
-    if (inst.mod == &cpu::ABS) {
-        res = std::format("${:04x}: {} ${:04x} ({}) {}c\n", pc, inst.name, (mem[pc + 1] | (mem[pc + 2] << 8)), "ABS", inst.cycles);
-    } else if (inst.mod == &cpu::ABSX) {
-        res = std::format("${:04x}: {} ${:04x}+x ({}) {}c\n", pc, inst.name, (mem[pc + 1] | (mem[pc + 2] << 8)), "ABSX", inst.cycles);
-    } else if (inst.mod == &cpu::ABSY) {
-        res = std::format("${:04x}: {} ${:04x}+y ({}) {}c\n", pc, inst.name, (mem[pc + 1] | (mem[pc + 2] << 8)), "ABSY", inst.cycles);
-    } else if (inst.mod == &cpu::ACC) {
-        res = std::format("${:04x}: {} ({}) {}c\n", pc, inst.name, "ACC", inst.cycles);
-    } else if (inst.mod == &cpu::IMM) {
-        res = std::format("${:04x}: {} #{:02x} ({}) {}c\n", pc, inst.name, mem[pc + 1], "IMM", inst.cycles);
-    } else if (inst.mod == &cpu::IMP) {
-        res = std::format("${:04x}: {} ({}) {}c\n", pc, inst.name, "IMP", inst.cycles);
-    } else if (inst.mod == &cpu::IND) {
-        res = std::format("${:04x}: {} $[${:02x}+x] ({}) {}c\n", pc, inst.name, mem[pc + 1], "IMP", inst.cycles);
-    } else if (inst.mod == &cpu::INDX) {
-        res = std::format("${:04x}: {} $[${:02x}+x] ({}) {}c\n", pc, inst.name, mem[pc + 1], "INDX", inst.cycles);
-    } else if (inst.mod == &cpu::INDY) {
-        res = std::format("${:04x}: {} $[${:02x}]+y ({}) {}c\n", pc, inst.name, mem[pc + 1], "INDY", inst.cycles);
-    } else if (inst.mod == &cpu::REL) {
-        res = std::format("${:04x}: {} ${:02x} ({}) {}c\n", pc, inst.name, mem[pc + 1], "REL", inst.cycles);
-    } else if (inst.mod == &cpu::ZP) {
-        res = std::format("${:04x}: {} ${:02x} ({}) {}c\n", pc, inst.name, mem[pc + 1], "ZP", inst.cycles);
-    } else if (inst.mod == &cpu::ZPX) {
-        res = std::format("${:04x}: {} ${:02x}+x ({}) {}c\n", pc, inst.name, mem[pc + 1], "ZPX", inst.cycles);
-    } else if (inst.mod == &cpu::ZPY) {
-        res = std::format("${:04x}: {} ${:02x}+y ({}) {}c\n", pc, inst.name, mem[pc + 1], "ZPY", inst.cycles);
-    } else {
-        std::unreachable();
-        abort();
-    }
-    return res;
-}
-
-const std::vector<instruction> cpu::inst_table = {
-    {"BRK", &cpu::BRK, &cpu::IMP, 7},
-    {"ORA", &cpu::ORA, &cpu::INDX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 3},
-    {"ORA", &cpu::ORA, &cpu::ZP, 3},
-    {"ASL", &cpu::ASL, &cpu::ZP, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"PHP", &cpu::PHP, &cpu::IMP, 3},
-    {"ORA", &cpu::ORA, &cpu::IMM, 2},
-    {"ASL", &cpu::ASL, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"ORA", &cpu::ORA, &cpu::ABS, 4},
-    {"ASL", &cpu::ASL, &cpu::ABS, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"BPL", &cpu::BPL, &cpu::REL, 2},
-    {"ORA", &cpu::ORA, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"ORA", &cpu::ORA, &cpu::ZPX, 4},
-    {"ASL", &cpu::ASL, &cpu::ZPX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"CLC", &cpu::CLC, &cpu::IMP, 2},
-    {"ORA", &cpu::ORA, &cpu::ABSY, 4},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"ORA", &cpu::ORA, &cpu::ABSX, 4},
-    {"ASL", &cpu::ASL, &cpu::ABSX, 7},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"JSR", &cpu::JSR, &cpu::ABS, 6},
-    {"AND", &cpu::AND, &cpu::INDX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"BIT", &cpu::BIT, &cpu::ZP, 3},
-    {"AND", &cpu::AND, &cpu::ZP, 3},
-    {"ROL", &cpu::ROL, &cpu::ZP, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"PLP", &cpu::PLP, &cpu::IMP, 4},
-    {"AND", &cpu::AND, &cpu::IMM, 2},
-    {"ROL", &cpu::ROL, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"BIT", &cpu::BIT, &cpu::ABS, 4},
-    {"AND", &cpu::AND, &cpu::ABS, 4},
-    {"ROL", &cpu::ROL, &cpu::ABS, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"BMI", &cpu::BMI, &cpu::REL, 2},
-    {"AND", &cpu::AND, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"AND", &cpu::AND, &cpu::ZPX, 4},
-    {"ROL", &cpu::ROL, &cpu::ZPX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"SEC", &cpu::SEC, &cpu::IMP, 2},
-    {"AND", &cpu::AND, &cpu::ABSY, 4},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"AND", &cpu::AND, &cpu::ABSX, 4},
-    {"ROL", &cpu::ROL, &cpu::ABSX, 7},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"RTI", &cpu::RTI, &cpu::IMP, 6},
-    {"EOR", &cpu::EOR, &cpu::INDX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 3},
-    {"EOR", &cpu::EOR, &cpu::ZP, 3},
-    {"LSR", &cpu::LSR, &cpu::ZP, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"PHA", &cpu::PHA, &cpu::IMP, 3},
-    {"EOR", &cpu::EOR, &cpu::IMM, 2},
-    {"LSR", &cpu::LSR, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"JMP", &cpu::JMP, &cpu::ABS, 3},
-    {"EOR", &cpu::EOR, &cpu::ABS, 4},
-    {"LSR", &cpu::LSR, &cpu::ABS, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"BVC", &cpu::BVC, &cpu::REL, 2},
-    {"EOR", &cpu::EOR, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"EOR", &cpu::EOR, &cpu::ZPX, 4},
-    {"LSR", &cpu::LSR, &cpu::ZPX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"CLI", &cpu::CLI, &cpu::IMP, 2},
-    {"EOR", &cpu::EOR, &cpu::ABSY, 4},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"EOR", &cpu::EOR, &cpu::ABSX, 4},
-    {"LSR", &cpu::LSR, &cpu::ABSX, 7},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"RTS", &cpu::RTS, &cpu::IMP, 6},
-    {"ADC", &cpu::ADC, &cpu::INDX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 3},
-    {"ADC", &cpu::ADC, &cpu::ZP, 3},
-    {"ROR", &cpu::ROR, &cpu::ZP, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"PLA", &cpu::PLA, &cpu::IMP, 4},
-    {"ADC", &cpu::ADC, &cpu::IMM, 2},
-    {"ROR", &cpu::ROR, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"JMP", &cpu::JMP, &cpu::IND, 5},
-    {"ADC", &cpu::ADC, &cpu::ABS, 4},
-    {"ROR", &cpu::ROR, &cpu::IMP, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"BVS", &cpu::BVS, &cpu::REL, 2},
-    {"ADC", &cpu::ADC, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"ADC", &cpu::ADC, &cpu::ZPX, 4},
-    {"ROR", &cpu::ROR, &cpu::ZPX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"SEI", &cpu::SEI, &cpu::IMP, 2},
-    {"ADC", &cpu::ADC, &cpu::ABSY, 4},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"ADC", &cpu::ADC, &cpu::ABSX, 4},
-    {"ROR", &cpu::ROR, &cpu::ABSX, 7},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"STA", &cpu::STA, &cpu::INDX, 6},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"STY", &cpu::STY, &cpu::ZP, 3},
-    {"STA", &cpu::STA, &cpu::ZP, 3},
-    {"STX", &cpu::STX, &cpu::ZP, 3},
-    {"???", &cpu::UNK, &cpu::ACC, 3},
-    {"DEY", &cpu::DEY, &cpu::IMP, 2},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"TXA", &cpu::TXA, &cpu::IMP, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"STY", &cpu::STY, &cpu::ABS, 4},
-    {"STA", &cpu::STA, &cpu::ABS, 4},
-    {"STX", &cpu::STX, &cpu::ABS, 4},
-    {"???", &cpu::UNK, &cpu::ACC, 4},
-    {"BCC", &cpu::BCC, &cpu::REL, 2},
-    {"STA", &cpu::STA, &cpu::INDY, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"STY", &cpu::STY, &cpu::ZPX, 4},
-    {"STA", &cpu::STA, &cpu::ZPX, 4},
-    {"STX", &cpu::STX, &cpu::ZPY, 4},
-    {"???", &cpu::UNK, &cpu::ACC, 4},
-    {"TYA", &cpu::TYA, &cpu::IMP, 2},
-    {"STA", &cpu::STA, &cpu::ABSY, 5},
-    {"TXS", &cpu::TXS, &cpu::IMP, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"???", &cpu::NOP, &cpu::ACC, 5},
-    {"STA", &cpu::STA, &cpu::ABSX, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"LDY", &cpu::LDY, &cpu::IMM, 2},
-    {"LDA", &cpu::LDA, &cpu::INDX, 6},
-    {"LDX", &cpu::LDX, &cpu::IMM, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"LDY", &cpu::LDY, &cpu::ZP, 3},
-    {"LDA", &cpu::LDA, &cpu::ZP, 3},
-    {"LDX", &cpu::LDX, &cpu::ZP, 3},
-    {"???", &cpu::UNK, &cpu::ACC, 3},
-    {"TAY", &cpu::TAY, &cpu::IMP, 2},
-    {"LDA", &cpu::LDA, &cpu::IMM, 2},
-    {"TAX", &cpu::TAX, &cpu::IMP, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"LDY", &cpu::LDY, &cpu::ABS, 4},
-    {"LDA", &cpu::LDA, &cpu::ABS, 4},
-    {"LDX", &cpu::LDX, &cpu::ABS, 4},
-    {"???", &cpu::UNK, &cpu::ACC, 4},
-    {"BCS", &cpu::BCS, &cpu::REL, 2},
-    {"LDA", &cpu::LDA, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"LDY", &cpu::LDY, &cpu::ZPX, 4},
-    {"LDA", &cpu::LDA, &cpu::ZPX, 4},
-    {"LDX", &cpu::LDX, &cpu::ZPY, 4},
-    {"???", &cpu::UNK, &cpu::ACC, 4},
-    {"CLV", &cpu::CLV, &cpu::IMP, 2},
-    {"LDA", &cpu::LDA, &cpu::ABSY, 4},
-    {"TSX", &cpu::TSX, &cpu::IMP, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 4},
-    {"LDY", &cpu::LDY, &cpu::ABSX, 4},
-    {"LDA", &cpu::LDA, &cpu::ABSX, 4},
-    {"LDX", &cpu::LDX, &cpu::ABSY, 4},
-    {"???", &cpu::UNK, &cpu::ACC, 4},
-    {"CPY", &cpu::CPY, &cpu::IMM, 2},
-    {"CMP", &cpu::CMP, &cpu::INDX, 6},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"CPY", &cpu::CPY, &cpu::ZP, 3},
-    {"CMP", &cpu::CMP, &cpu::ZP, 3},
-    {"DEC", &cpu::DEC, &cpu::ZP, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"INY", &cpu::INY, &cpu::IMP, 2},
-    {"CMP", &cpu::CMP, &cpu::IMM, 2},
-    {"DEX", &cpu::DEX, &cpu::IMP, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"CPY", &cpu::CPY, &cpu::ABS, 4},
-    {"CMP", &cpu::CMP, &cpu::ABS, 4},
-    {"DEC", &cpu::DEC, &cpu::ABS, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"BNE", &cpu::BNE, &cpu::REL, 2},
-    {"CMP", &cpu::CMP, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"CMP", &cpu::CMP, &cpu::ZPX, 4},
-    {"DEC", &cpu::DEC, &cpu::ZPX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"CLD", &cpu::CLD, &cpu::IMP, 2},
-    {"CMP", &cpu::CMP, &cpu::ABSY, 4},
-    {"NOP", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"CMP", &cpu::CMP, &cpu::ABSX, 4},
-    {"DEC", &cpu::DEC, &cpu::ABSX, 7},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"CPX", &cpu::CPX, &cpu::IMM, 2},
-    {"SBC", &cpu::SBC, &cpu::INDX, 6},
-    {"???", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"CPX", &cpu::CPX, &cpu::ZP, 3},
-    {"SBC", &cpu::SBC, &cpu::ZP, 3},
-    {"INC", &cpu::INC, &cpu::ZP, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 5},
-    {"INX", &cpu::INX, &cpu::IMP, 2},
-    {"SBC", &cpu::SBC, &cpu::IMM, 2},
-    {"NOP", &cpu::NOP, &cpu::IMP, 2},
-    {"???", &cpu::SBC, &cpu::ACC, 2},
-    {"CPX", &cpu::CPX, &cpu::ABS, 4},
-    {"SBC", &cpu::SBC, &cpu::ABS, 4},
-    {"INC", &cpu::INC, &cpu::ABS, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"BEQ", &cpu::BEQ, &cpu::REL, 2},
-    {"SBC", &cpu::SBC, &cpu::INDY, 5},
-    {"???", &cpu::UNK, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 8},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"SBC", &cpu::SBC, &cpu::ZPX, 4},
-    {"INC", &cpu::INC, &cpu::ZPX, 6},
-    {"???", &cpu::UNK, &cpu::ACC, 6},
-    {"SED", &cpu::SED, &cpu::IMP, 2},
-    {"SBC", &cpu::SBC, &cpu::ABSY, 4},
-    {"NOP", &cpu::NOP, &cpu::ACC, 2},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
-    {"???", &cpu::NOP, &cpu::ACC, 4},
-    {"SBC", &cpu::SBC, &cpu::ABSX, 4},
-    {"INC", &cpu::INC, &cpu::ABSX, 7},
-    {"???", &cpu::UNK, &cpu::ACC, 7},
+// 指令定义，仅在编译期使用，拆分为热表 inst_table 与冷表 inst_infos
+template <typename Cpu>
+struct inst_def {
+    std::string_view name;
+    typename Cpu::opt_type opt;
+    addr_mode mod;
+    uint8_t cycles;
 };
+
+template <typename Cpu>
+constexpr std::array<inst_def<Cpu>, 256> inst_defs = {{
+    {"BRK", &Cpu::BRK, addr_mode::IMP, 7},
+    {"ORA", &Cpu::ORA, addr_mode::INDX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 3},
+    {"ORA", &Cpu::ORA, addr_mode::ZP, 3},
+    {"ASL", &Cpu::template ASL<addr_mode::ZP>, addr_mode::ZP, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"PHP", &Cpu::PHP, addr_mode::IMP, 3},
+    {"ORA", &Cpu::ORA, addr_mode::IMM, 2},
+    {"ASL", &Cpu::template ASL<addr_mode::ACC>, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"ORA", &Cpu::ORA, addr_mode::ABS, 4},
+    {"ASL", &Cpu::template ASL<addr_mode::ABS>, addr_mode::ABS, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"BPL", &Cpu::BPL, addr_mode::REL, 2},
+    {"ORA", &Cpu::ORA, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"ORA", &Cpu::ORA, addr_mode::ZPX, 4},
+    {"ASL", &Cpu::template ASL<addr_mode::ZPX>, addr_mode::ZPX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"CLC", &Cpu::CLC, addr_mode::IMP, 2},
+    {"ORA", &Cpu::ORA, addr_mode::ABSY, 4},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"ORA", &Cpu::ORA, addr_mode::ABSX, 4},
+    {"ASL", &Cpu::template ASL<addr_mode::ABSX>, addr_mode::ABSX, 7},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"JSR", &Cpu::JSR, addr_mode::ABS, 6},
+    {"AND", &Cpu::AND, addr_mode::INDX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"BIT", &Cpu::BIT, addr_mode::ZP, 3},
+    {"AND", &Cpu::AND, addr_mode::ZP, 3},
+    {"ROL", &Cpu::template ROL<addr_mode::ZP>, addr_mode::ZP, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"PLP", &Cpu::PLP, addr_mode::IMP, 4},
+    {"AND", &Cpu::AND, addr_mode::IMM, 2},
+    {"ROL", &Cpu::template ROL<addr_mode::ACC>, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"BIT", &Cpu::BIT, addr_mode::ABS, 4},
+    {"AND", &Cpu::AND, addr_mode::ABS, 4},
+    {"ROL", &Cpu::template ROL<addr_mode::ABS>, addr_mode::ABS, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"BMI", &Cpu::BMI, addr_mode::REL, 2},
+    {"AND", &Cpu::AND, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"AND", &Cpu::AND, addr_mode::ZPX, 4},
+    {"ROL", &Cpu::template ROL<addr_mode::ZPX>, addr_mode::ZPX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"SEC", &Cpu::SEC, addr_mode::IMP, 2},
+    {"AND", &Cpu::AND, addr_mode::ABSY, 4},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"AND", &Cpu::AND, addr_mode::ABSX, 4},
+    {"ROL", &Cpu::template ROL<addr_mode::ABSX>, addr_mode::ABSX, 7},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"RTI", &Cpu::RTI, addr_mode::IMP, 6},
+    {"EOR", &Cpu::EOR, addr_mode::INDX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 3},
+    {"EOR", &Cpu::EOR, addr_mode::ZP, 3},
+    {"LSR", &Cpu::template LSR<addr_mode::ZP>, addr_mode::ZP, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"PHA", &Cpu::PHA, addr_mode::IMP, 3},
+    {"EOR", &Cpu::EOR, addr_mode::IMM, 2},
+    {"LSR", &Cpu::template LSR<addr_mode::ACC>, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"JMP", &Cpu::JMP, addr_mode::ABS, 3},
+    {"EOR", &Cpu::EOR, addr_mode::ABS, 4},
+    {"LSR", &Cpu::template LSR<addr_mode::ABS>, addr_mode::ABS, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"BVC", &Cpu::BVC, addr_mode::REL, 2},
+    {"EOR", &Cpu::EOR, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"EOR", &Cpu::EOR, addr_mode::ZPX, 4},
+    {"LSR", &Cpu::template LSR<addr_mode::ZPX>, addr_mode::ZPX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"CLI", &Cpu::CLI, addr_mode::IMP, 2},
+    {"EOR", &Cpu::EOR, addr_mode::ABSY, 4},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"EOR", &Cpu::EOR, addr_mode::ABSX, 4},
+    {"LSR", &Cpu::template LSR<addr_mode::ABSX>, addr_mode::ABSX, 7},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"RTS", &Cpu::RTS, addr_mode::IMP, 6},
+    {"ADC", &Cpu::ADC, addr_mode::INDX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 3},
+    {"ADC", &Cpu::ADC, addr_mode::ZP, 3},
+    {"ROR", &Cpu::template ROR<addr_mode::ZP>, addr_mode::ZP, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"PLA", &Cpu::PLA, addr_mode::IMP, 4},
+    {"ADC", &Cpu::ADC, addr_mode::IMM, 2},
+    {"ROR", &Cpu::template ROR<addr_mode::ACC>, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"JMP", &Cpu::JMP, addr_mode::IND, 5},
+    {"ADC", &Cpu::ADC, addr_mode::ABS, 4},
+    {"ROR", &Cpu::template ROR<addr_mode::ABS>, addr_mode::ABS, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"BVS", &Cpu::BVS, addr_mode::REL, 2},
+    {"ADC", &Cpu::ADC, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"ADC", &Cpu::ADC, addr_mode::ZPX, 4},
+    {"ROR", &Cpu::template ROR<addr_mode::ZPX>, addr_mode::ZPX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"SEI", &Cpu::SEI, addr_mode::IMP, 2},
+    {"ADC", &Cpu::ADC, addr_mode::ABSY, 4},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"ADC", &Cpu::ADC, addr_mode::ABSX, 4},
+    {"ROR", &Cpu::template ROR<addr_mode::ABSX>, addr_mode::ABSX, 7},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"STA", &Cpu::STA, addr_mode::INDX, 6},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"STY", &Cpu::STY, addr_mode::ZP, 3},
+    {"STA", &Cpu::STA, addr_mode::ZP, 3},
+    {"STX", &Cpu::STX, addr_mode::ZP, 3},
+    {"???", &Cpu::UNK, addr_mode::ACC, 3},
+    {"DEY", &Cpu::DEY, addr_mode::IMP, 2},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"TXA", &Cpu::TXA, addr_mode::IMP, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"STY", &Cpu::STY, addr_mode::ABS, 4},
+    {"STA", &Cpu::STA, addr_mode::ABS, 4},
+    {"STX", &Cpu::STX, addr_mode::ABS, 4},
+    {"???", &Cpu::UNK, addr_mode::ACC, 4},
+    {"BCC", &Cpu::BCC, addr_mode::REL, 2},
+    {"STA", &Cpu::STA, addr_mode::INDY, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"STY", &Cpu::STY, addr_mode::ZPX, 4},
+    {"STA", &Cpu::STA, addr_mode::ZPX, 4},
+    {"STX", &Cpu::STX, addr_mode::ZPY, 4},
+    {"???", &Cpu::UNK, addr_mode::ACC, 4},
+    {"TYA", &Cpu::TYA, addr_mode::IMP, 2},
+    {"STA", &Cpu::STA, addr_mode::ABSY, 5},
+    {"TXS", &Cpu::TXS, addr_mode::IMP, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"???", &Cpu::NOP, addr_mode::ACC, 5},
+    {"STA", &Cpu::STA, addr_mode::ABSX, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"LDY", &Cpu::LDY, addr_mode::IMM, 2},
+    {"LDA", &Cpu::LDA, addr_mode::INDX, 6},
+    {"LDX", &Cpu::LDX, addr_mode::IMM, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"LDY", &Cpu::LDY, addr_mode::ZP, 3},
+    {"LDA", &Cpu::LDA, addr_mode::ZP, 3},
+    {"LDX", &Cpu::LDX, addr_mode::ZP, 3},
+    {"???", &Cpu::UNK, addr_mode::ACC, 3},
+    {"TAY", &Cpu::TAY, addr_mode::IMP, 2},
+    {"LDA", &Cpu::LDA, addr_mode::IMM, 2},
+    {"TAX", &Cpu::TAX, addr_mode::IMP, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"LDY", &Cpu::LDY, addr_mode::ABS, 4},
+    {"LDA", &Cpu::LDA, addr_mode::ABS, 4},
+    {"LDX", &Cpu::LDX, addr_mode::ABS, 4},
+    {"???", &Cpu::UNK, addr_mode::ACC, 4},
+    {"BCS", &Cpu::BCS, addr_mode::REL, 2},
+    {"LDA", &Cpu::LDA, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"LDY", &Cpu::LDY, addr_mode::ZPX, 4},
+    {"LDA", &Cpu::LDA, addr_mode::ZPX, 4},
+    {"LDX", &Cpu::LDX, addr_mode::ZPY, 4},
+    {"???", &Cpu::UNK, addr_mode::ACC, 4},
+    {"CLV", &Cpu::CLV, addr_mode::IMP, 2},
+    {"LDA", &Cpu::LDA, addr_mode::ABSY, 4},
+    {"TSX", &Cpu::TSX, addr_mode::IMP, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 4},
+    {"LDY", &Cpu::LDY, addr_mode::ABSX, 4},
+    {"LDA", &Cpu::LDA, addr_mode::ABSX, 4},
+    {"LDX", &Cpu::LDX, addr_mode::ABSY, 4},
+    {"???", &Cpu::UNK, addr_mode::ACC, 4},
+    {"CPY", &Cpu::CPY, addr_mode::IMM, 2},
+    {"CMP", &Cpu::CMP, addr_mode::INDX, 6},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"CPY", &Cpu::CPY, addr_mode::ZP, 3},
+    {"CMP", &Cpu::CMP, addr_mode::ZP, 3},
+    {"DEC", &Cpu::DEC, addr_mode::ZP, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"INY", &Cpu::INY, addr_mode::IMP, 2},
+    {"CMP", &Cpu::CMP, addr_mode::IMM, 2},
+    {"DEX", &Cpu::DEX, addr_mode::IMP, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"CPY", &Cpu::CPY, addr_mode::ABS, 4},
+    {"CMP", &Cpu::CMP, addr_mode::ABS, 4},
+    {"DEC", &Cpu::DEC, addr_mode::ABS, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"BNE", &Cpu::BNE, addr_mode::REL, 2},
+    {"CMP", &Cpu::CMP, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"CMP", &Cpu::CMP, addr_mode::ZPX, 4},
+    {"DEC", &Cpu::DEC, addr_mode::ZPX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"CLD", &Cpu::CLD, addr_mode::IMP, 2},
+    {"CMP", &Cpu::CMP, addr_mode::ABSY, 4},
+    {"NOP", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"CMP", &Cpu::CMP, addr_mode::ABSX, 4},
+    {"DEC", &Cpu::DEC, addr_mode::ABSX, 7},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"CPX", &Cpu::CPX, addr_mode::IMM, 2},
+    {"SBC", &Cpu::SBC, addr_mode::INDX, 6},
+    {"???", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"CPX", &Cpu::CPX, addr_mode::ZP, 3},
+    {"SBC", &Cpu::SBC, addr_mode::ZP, 3},
+    {"INC", &Cpu::INC, addr_mode::ZP, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 5},
+    {"INX", &Cpu::INX, addr_mode::IMP, 2},
+    {"SBC", &Cpu::SBC, addr_mode::IMM, 2},
+    {"NOP", &Cpu::NOP, addr_mode::IMP, 2},
+    {"???", &Cpu::SBC, addr_mode::IMM, 2},
+    {"CPX", &Cpu::CPX, addr_mode::ABS, 4},
+    {"SBC", &Cpu::SBC, addr_mode::ABS, 4},
+    {"INC", &Cpu::INC, addr_mode::ABS, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"BEQ", &Cpu::BEQ, addr_mode::REL, 2},
+    {"SBC", &Cpu::SBC, addr_mode::INDY, 5},
+    {"???", &Cpu::UNK, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 8},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"SBC", &Cpu::SBC, addr_mode::ZPX, 4},
+    {"INC", &Cpu::INC, addr_mode::ZPX, 6},
+    {"???", &Cpu::UNK, addr_mode::ACC, 6},
+    {"SED", &Cpu::SED, addr_mode::IMP, 2},
+    {"SBC", &Cpu::SBC, addr_mode::ABSY, 4},
+    {"NOP", &Cpu::NOP, addr_mode::ACC, 2},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+    {"???", &Cpu::NOP, addr_mode::ACC, 4},
+    {"SBC", &Cpu::SBC, addr_mode::ABSX, 4},
+    {"INC", &Cpu::INC, addr_mode::ABSX, 7},
+    {"???", &Cpu::UNK, addr_mode::ACC, 7},
+}};
+
+constexpr auto mode_len(addr_mode mod) -> uint8_t {
+    switch (mod) {
+        case addr_mode::ACC:
+        case addr_mode::IMP:
+            return 1;
+        case addr_mode::IMM:
+        case addr_mode::INDX:
+        case addr_mode::INDY:
+        case addr_mode::REL:
+        case addr_mode::ZP:
+        case addr_mode::ZPX:
+        case addr_mode::ZPY:
+            return 2;
+        case addr_mode::ABS:
+        case addr_mode::ABSX:
+        case addr_mode::ABSY:
+        case addr_mode::IND:
+            return 3;
+    }
+    return 1;
+}
+
+template <typename Bus>
+constexpr std::array<typename basic_cpu<Bus>::instruction, 256> basic_cpu<Bus>::inst_table = []<std::size_t... I>(std::index_sequence<I...>) {
+    constexpr auto &defs = inst_defs<basic_cpu>;
+    return std::array<instruction, 256>{
+        instruction{&basic_cpu::exec<defs[I].opt, defs[I].mod>, defs[I].mod, defs[I].cycles, mode_len(defs[I].mod)}...};
+}(std::make_index_sequence<256>{});
+
+template <typename Bus>
+constexpr std::array<typename basic_cpu<Bus>::decoded_handler, 256> basic_cpu<Bus>::decoded_table = []<std::size_t... I>(std::index_sequence<I...>) {
+    constexpr auto &defs = inst_defs<basic_cpu>;
+    return std::array<decoded_handler, 256>{&basic_cpu::exec_decoded<defs[I].opt, defs[I].mod>...};
+}(std::make_index_sequence<256>{});
+
+template <typename Bus>
+constexpr std::array<inst_info, 256> basic_cpu<Bus>::inst_infos = [] {
+    constexpr auto &defs = inst_defs<basic_cpu>;
+    auto table = std::array<inst_info, 256>{};
+    for (auto i = 0; i < 256; ++i) {
+        const auto opt = defs[i].opt;
+        // cli、plp 解除中断屏蔽后需要在指令边界回到 bus（见 unmask_irq）
+        const auto ends_block = defs[i].mod == addr_mode::REL || opt == &basic_cpu::JMP || opt == &basic_cpu::JSR ||
+                                opt == &basic_cpu::RTS || opt == &basic_cpu::RTI || opt == &basic_cpu::BRK || opt == &basic_cpu::UNK ||
+                                opt == &basic_cpu::CLI || opt == &basic_cpu::PLP;
+        // 只读取操作数或只修改寄存器的指令，移位指令只有操作累加器时才算
+        constexpr std::string_view pure[] = {"LDA", "LDX", "LDY", "CMP", "CPX", "CPY", "BIT", "AND", "ORA", "EOR",
+                                             "ADC", "SBC", "TAX", "TAY", "TXA", "TYA", "TSX", "INX", "INY", "DEX",
+                                             "DEY", "CLC", "SEC", "CLV", "CLD", "SED", "CLI", "SEI", "NOP"};
+        const auto mod = defs[i].mod;
+        const auto idle_safe = std::ranges::find(pure, defs[i].name) != std::end(pure) || mod == addr_mode::REL ||
+                               (opt == &basic_cpu::JMP && mod == addr_mode::ABS) ||
+                               (mod == addr_mode::ACC && opt != &basic_cpu::UNK);
+        table[i] = {defs[i].name, ends_block, idle_safe};
+    }
+    return table;
+}();
+
+// 分支与 jmp，可能跳回循环开头
+template <typename Cpu>
+constexpr auto is_jump(uint8_t opcode) -> bool {
+    return inst_defs<Cpu>[opcode].mod == addr_mode::REL || inst_defs<Cpu>[opcode].opt == &Cpu::JMP;
+}
+
+// 按 0x00 ~ 0xff 展开 256 个操作码
+#define NES_OP16(X, h) X(h##0) X(h##1) X(h##2) X(h##3) X(h##4) X(h##5) X(h##6) X(h##7) \
+    X(h##8) X(h##9) X(h##A) X(h##B) X(h##C) X(h##D) X(h##E) X(h##F)
+#define NES_OP256(X) NES_OP16(X, 0x0) NES_OP16(X, 0x1) NES_OP16(X, 0x2) NES_OP16(X, 0x3) \
+    NES_OP16(X, 0x4) NES_OP16(X, 0x5) NES_OP16(X, 0x6) NES_OP16(X, 0x7)                 \
+    NES_OP16(X, 0x8) NES_OP16(X, 0x9) NES_OP16(X, 0xA) NES_OP16(X, 0xB)                 \
+    NES_OP16(X, 0xC) NES_OP16(X, 0xD) NES_OP16(X, 0xE) NES_OP16(X, 0xF)
+#define NES_EXEC_ON(n, c) exec<inst_defs<basic_cpu>[n].opt, inst_defs<basic_cpu>[n].mod>(c)
+#define NES_EXEC(n) NES_EXEC_ON(n, *this)
+#define NES_IDLE(n)                        \
+    if constexpr (is_jump<basic_cpu>(n)) { \
+        if (r_pc_ <= pc) {                 \
+            skip_idle();                   \
+        }                                  \
+    }
+
+// 每个操作码有独立的分派点，间接跳转的预测按操作码区分
+#if defined(__GNUC__)
+template <typename Bus>
+auto basic_cpu<Bus>::run_threaded() -> void {
+#define NES_LABEL(n) &&op_##n,
+#define NES_THREAD(n)                       \
+    op_##n : cycles_ = inst_defs<basic_cpu>[n].cycles; \
+    NES_EXEC(n);                            \
+    clocks_ += cycles_;                     \
+    NES_IDLE(n);                            \
+    if (clocks_ >= deadline_) {             \
+        goto done;                          \
+    }                                       \
+    pc = r_pc_;                             \
+    goto *labels[next_pc()];
+
+    static const void *labels[256] = {NES_OP256(NES_LABEL)};
+    auto pc = r_pc_;
+    goto *labels[next_pc()];
+    NES_OP256(NES_THREAD)
+done:
+    cycles_ = 0;
+
+#undef NES_LABEL
+#undef NES_THREAD
+}
+#else
+template <typename Bus>
+auto basic_cpu<Bus>::run_threaded() -> void {
+#define NES_CASE(n)                    \
+    case n:                            \
+        cycles_ = inst_defs<basic_cpu>[n].cycles; \
+        NES_EXEC(n);                   \
+        clocks_ += cycles_;            \
+        NES_IDLE(n);                   \
+        break;
+
+    do {
+        const auto pc = r_pc_;
+        switch (next_pc()) {
+            NES_OP256(NES_CASE)
+        }
+    } while (clocks_ < deadline_);
+    cycles_ = 0;
+
+#undef NES_CASE
+}
+#endif
+
+template <typename Bus>
+template <uint8_t Op>
+auto basic_cpu<Bus>::op(basic_cpu &c) -> uint8_t {
+    c.cycles_ = inst_defs<basic_cpu>[Op].cycles;
+    NES_EXEC_ON(Op, c);
+    return c.cycles_;
+}
+
+// 成员函数定义在这里，所有支持的 bus 都在这里实例化，访存函数可以内联
+#define NES_INSTANTIATE_CPU(B) template class basic_cpu<B>;
+NES_FOR_EACH_BUS(NES_INSTANTIATE_CPU)
+#undef NES_INSTANTIATE_CPU
+template class basic_cpu<cpu_bus>;
+
+// 预编译代码直接调用 op<Op>，需要为每种 bus 显式实例化全部操作码，
+// make_console 为 nrom 创建的 basic_bus<nrom> 同样可以加载预编译代码
+#define NES_OP16_ON(X, Bus, h)                                                                                   \
+    X(Bus, h##0) X(Bus, h##1) X(Bus, h##2) X(Bus, h##3) X(Bus, h##4) X(Bus, h##5) X(Bus, h##6) X(Bus, h##7)     \
+    X(Bus, h##8) X(Bus, h##9) X(Bus, h##A) X(Bus, h##B) X(Bus, h##C) X(Bus, h##D) X(Bus, h##E) X(Bus, h##F)
+#define NES_INSTANTIATE(B, n) template auto basic_cpu<B>::op<n>(basic_cpu<B> & c) -> uint8_t;
+#define NES_INSTANTIATE_OPS(B)                                                                                     \
+    NES_OP16_ON(NES_INSTANTIATE, B, 0x0) NES_OP16_ON(NES_INSTANTIATE, B, 0x1) NES_OP16_ON(NES_INSTANTIATE, B, 0x2) \
+    NES_OP16_ON(NES_INSTANTIATE, B, 0x3) NES_OP16_ON(NES_INSTANTIATE, B, 0x4) NES_OP16_ON(NES_INSTANTIATE, B, 0x5) \
+    NES_OP16_ON(NES_INSTANTIATE, B, 0x6) NES_OP16_ON(NES_INSTANTIATE, B, 0x7) NES_OP16_ON(NES_INSTANTIATE, B, 0x8) \
+    NES_OP16_ON(NES_INSTANTIATE, B, 0x9) NES_OP16_ON(NES_INSTANTIATE, B, 0xA) NES_OP16_ON(NES_INSTANTIATE, B, 0xB) \
+    NES_OP16_ON(NES_INSTANTIATE, B, 0xC) NES_OP16_ON(NES_INSTANTIATE, B, 0xD) NES_OP16_ON(NES_INSTANTIATE, B, 0xE) \
+    NES_OP16_ON(NES_INSTANTIATE, B, 0xF)
+NES_FOR_EACH_BUS(NES_INSTANTIATE_OPS)
+#undef NES_INSTANTIATE_OPS
+#undef NES_INSTANTIATE
+#undef NES_OP16_ON
+
+#undef NES_EXEC_ON
+#undef NES_EXEC
+#undef NES_IDLE
+#undef NES_OP256
+#undef NES_OP16
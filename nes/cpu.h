@@ -1,10 +1,47 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <concepts>
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
-struct instruction;
-class bus;
+template <typename Cpu>
+struct basic_instruction;
+template <typename Cpu>
+struct basic_code_block;
+template <typename Cpu>
+struct basic_decoded_inst;
+struct inst_info;
+
+// 寻址模式
+enum class addr_mode : uint8_t {
+    ABS,
+    ABSX,
+    ABSY,
+    ACC,
+    IMM,
+    IMP,
+    IND,
+    INDX,
+    INDY,
+    REL,
+    ZP,
+    ZPX,
+    ZPY,
+};
+
+// 解释器分派方式
+enum class dispatch_mode : uint8_t {
+    table,    // 逐条查表调用，调试器使用
+    threaded, // 在一个函数内批量执行，computed goto 或 switch 分派
+    block,    // 将 prg rom 中的基本块翻译为处理函数序列后执行，ram 中的代码仍由解释器执行
+    checked,  // 同 block，但每个块执行后用查表解释器从同一状态重新执行一遍并比较结果（lockstep）
+    aot,      // 执行预编译的代码，没有对应代码的地址由解释器执行
+    cached,   // 逐条执行，但使用按 pc 缓存的译码结果
+};
 
 // 状态寄存器
 struct status_register {
@@ -18,13 +55,42 @@ struct status_register {
     unsigned N : 1 {};
 };
 
-class cpu {
+// cpu 访问内存所需的接口
+template <typename T>
+concept cpu_bus_interface = requires(T &b, uint16_t addr, uint8_t data) {
+    { b.cpu_bus_read(addr) } -> std::same_as<uint8_t>;
+    b.cpu_bus_write(addr, data);
+};
+
+// 能在缓存过代码的页被写入时通知 cpu（见 ram_written、invalidate_code）
+template <typename T>
+concept code_watching_bus = cpu_bus_interface<T> && requires(T &b, uint16_t addr) { b.trap_writes(addr); };
+
+// 以 bus 类型为参数，访存在编译期确定并内联，实例化见 cpu.cpp
+template <typename Bus>
+class basic_cpu {
   public:
-    using opt_type = void (cpu::*)();  // 指令操作
-    using addr_mode = void (cpu::*)(); // 寻址模式
+    using opt_type = void (basic_cpu::*)();                          // 指令操作
+    using handler_type = void (*)(basic_cpu &);                      // 融合后的指令处理函数
+    using decoded_handler = void (*)(basic_cpu &, uint16_t operand); // 使用预译码操作数的处理函数
+    // 预编译代码入口，执行 pc 处的基本块，没有对应代码时返回 false。
+    // 与其他批量执行模式相同，io 处理函数依赖 clocks_ 为当前指令开始的时刻，
+    // 所以生成的代码必须逐条通过 aot_op 执行，每条指令的周期执行完立即计入 clocks_
+    using aot_entry = bool (*)(basic_cpu &);
+    using instruction = basic_instruction<basic_cpu>;
+    using decoded_inst = basic_decoded_inst<basic_cpu>;
+    using code_block = basic_code_block<basic_cpu>;
 
   public:
-    explicit cpu(bus &b) : bus_(b) {}
+    // 译码缓存与基本块依赖 bus 通知代码修改，其他 bus 上这些模式退回 threaded
+    explicit basic_cpu(Bus &b, dispatch_mode mode = dispatch_mode::table) : bus_(b), mode_(mode) {
+        static_assert(cpu_bus_interface<Bus>);
+        if constexpr (!code_watching_bus<Bus>) {
+            if (mode_ == dispatch_mode::block || mode_ == dispatch_mode::checked || mode_ == dispatch_mode::cached) {
+                mode_ = dispatch_mode::threaded;
+            }
+        }
+    }
 
     // 指令
   public:
@@ -51,12 +117,12 @@ class cpu {
     auto TYA() -> void;                  // a = y
 
     // 流程控制
-    auto BMI() -> void { branch_if(r_stat_.N); }  // if (n) then branch
-    auto BPL() -> void { branch_if(!r_stat_.N); } // if (!n) then branch
+    auto BMI() -> void { branch_if(flag_n()); }  // if (n) then branch
+    auto BPL() -> void { branch_if(!flag_n()); } // if (!n) then branch
     auto BVS() -> void { branch_if(r_stat_.V); }  // if (v) then branch
     auto BVC() -> void { branch_if(!r_stat_.V); } // if (!v) then branch
-    auto BEQ() -> void { branch_if(r_stat_.Z); }  // if (z) then branch
-    auto BNE() -> void { branch_if(!r_stat_.Z); } // if (!z) then branch
+    auto BEQ() -> void { branch_if(flag_z()); }  // if (z) then branch
+    auto BNE() -> void { branch_if(!flag_z()); } // if (!z) then branch
     auto BCS() -> void { branch_if(r_stat_.C); }  // if (c) then branch
     auto BCC() -> void { branch_if(!r_stat_.C); } // if (!c) then branch
     auto JMP() -> void { r_pc_ = addr_; }         // 无条件跳转
@@ -69,7 +135,7 @@ class cpu {
     auto CLV() -> void { r_stat_.V = 0; }
     auto CLD() -> void { r_stat_.D = 0; }
     auto SED() -> void { r_stat_.D = 1; }
-    auto CLI() -> void { r_stat_.I = 0; }
+    auto CLI() -> void { unmask_irq(); }
     auto SEI() -> void { r_stat_.I = 1; }
     auto CLC() -> void { r_stat_.C = 0; }
     auto SEC() -> void { r_stat_.C = 1; }
@@ -89,10 +155,14 @@ class cpu {
     auto CPX() -> void; // x - fetched
     auto CPY() -> void; // y - fetched
 
-    // 位移指令
+    // 位移指令，累加器寻址时操作 a，否则操作内存
+    template <addr_mode Mod>
     auto ASL() -> void; // 算数左移一位
+    template <addr_mode Mod>
     auto LSR() -> void; // 逻辑右移一位
+    template <addr_mode Mod>
     auto ROL() -> void;
+    template <addr_mode Mod>
     auto ROR() -> void;
 
     // 递增、递减指令
@@ -124,11 +194,39 @@ class cpu {
     auto ZPY() -> void { addr_ = (next_pc() + r_y_) & 0xff; }               // zero page y           add = mem[pc] + y
 
   public:
-    auto next_clock() -> void; // 执行一次时钟周期
-    auto next_inst() -> void;  // 执行一条指令
-    auto reset() -> void;      // 重置
-    auto irq() -> void;        // 中断
-    auto nmi() -> void;        // 不可屏蔽中断
+    auto next_clock() -> void;                     // 执行一次时钟周期
+    auto next_inst() -> void;                      // 执行一条指令
+    auto run_cycles(uint32_t n) -> uint32_t;       // 执行至少 n 个周期，返回超出的周期数
+    auto run_to(uint64_t deadline) -> uint32_t;    // 执行到 clocks() >= deadline，返回超出的周期数
+    auto invalidate_code(uint16_t lo, uint16_t hi) -> void; // [lo, hi] 处代码被修改，丢弃与之重叠的基本块
+    auto load_aot(aot_entry entry) -> void;                 // 使用预编译代码执行
+
+    // 批量执行期间由 io 处理函数调用
+    auto limit_deadline(uint64_t t) -> void { deadline_ = std::min(deadline_, t); } // 本次执行最晚在 t 结束
+    auto stall(uint32_t cycles) -> void { // 暂停若干周期，如 oam dma
+        clocks_ += cycles;
+        stalled_ += cycles;
+    }
+
+    // 写入缓存过代码的 ram 页时由 bus 调用（见 bus::trap_writes），使译码结果失效
+    auto ram_written(uint16_t addr) -> void {
+        if (ram_code_pages_ & (1u << ((addr & 0x7ff) >> 8))) [[unlikely]] {
+            invalidate_code(addr, addr);
+        }
+    }
+    auto reset() -> void;                          // 重置
+    auto irq() -> void;                            // 中断
+    auto nmi() -> void;                            // 不可屏蔽中断
+
+    // 执行到 pred() 为真或到达 deadline，每条指令后检查一次 pred
+    template <typename Pred>
+    auto run_until(uint64_t deadline, Pred pred) -> uint32_t {
+        deadline_ = deadline;
+        while (clocks_ < deadline_ && !pred()) {
+            next_inst();
+        }
+        return clocks_ > deadline ? clocks_ - deadline : 0;
+    }
 
   private:
     auto read(uint16_t addr) -> uint8_t;
@@ -137,11 +235,83 @@ class cpu {
     auto stack_pull() -> uint8_t { return read(0x100 + (++r_sp_)); }
     auto push_pc() -> void;
     auto pull_pc() -> void { r_pc_ = stack_pull() | (stack_pull() << 8); }
-    auto push_stat() -> void { stack_push(*reinterpret_cast<uint8_t *>(&r_stat_)); }
-    auto pull_stat() -> void { *reinterpret_cast<uint8_t *>(&r_stat_) = stack_pull(); }
-    auto next_pc() -> uint8_t { return read(r_pc_++); }
+    auto push_stat() -> void {
+        sync_nz();
+        stack_push(*reinterpret_cast<uint8_t *>(&r_stat_));
+    }
+    auto pull_stat() -> void { // plp、rti 清除 i 时同 unmask_irq
+        const auto masked = r_stat_.I;
+        *reinterpret_cast<uint8_t *>(&r_stat_) = stack_pull();
+        nz_lazy_ = false;
+        if (masked && !r_stat_.I) {
+            limit_deadline(clocks_);
+        }
+    }
+    // 解除中断屏蔽时结束本次批量执行，bus 可以在下一条指令前响应等待中的中断
+    auto unmask_irq() -> void {
+        if (r_stat_.I) {
+            limit_deadline(clocks_);
+        }
+        r_stat_.I = 0;
+    }
+    auto next_pc() -> uint8_t { return bus_.cpu_bus_read(r_pc_++); } // 取指不计入 lockstep 的访存序列
     auto fetch() -> uint8_t;
+    template <addr_mode Mod>
+    auto address() -> void; // 按寻址模式计算地址
+    template <addr_mode Mod>
+    auto operand() -> uint8_t; // 读取操作数
+    template <addr_mode Mod>
+    auto store(uint8_t data) -> void; // 写回结果
+    template <opt_type Opt, addr_mode Mod>
+    static auto exec(basic_cpu &c) -> void; // 执行一条指令
+    template <addr_mode Mod>
+    auto address_decoded(uint16_t operand) -> void; // 按预译码的操作数计算地址
+    template <opt_type Opt, addr_mode Mod>
+    static auto exec_decoded(basic_cpu &c, uint16_t operand) -> void; // 执行一条预译码的指令
     auto branch_if(bool cond) -> void;
+#ifdef NES_LAZY_FLAGS
+    // 只记录最后一次结果，n/z 在分支、压栈或读取状态时才计算
+    auto set_nz(uint8_t v) -> void {
+        nz_ = v;
+        nz_lazy_ = true;
+    }
+    auto flag_n() -> bool { return nz_lazy_ ? (nz_ >> 7) != 0 : r_stat_.N; }
+    auto flag_z() -> bool { return nz_lazy_ ? nz_ == 0 : r_stat_.Z; }
+    auto sync_nz() -> void {
+        if (nz_lazy_) {
+            r_stat_.N = nz_ >> 7;
+            r_stat_.Z = nz_ == 0;
+            nz_lazy_ = false;
+        }
+    }
+#else
+    auto set_nz(uint8_t v) -> void {
+        r_stat_.N = v >> 7;
+        r_stat_.Z = v == 0;
+    }
+    auto flag_n() -> bool { return r_stat_.N; }
+    auto flag_z() -> bool { return r_stat_.Z; }
+    auto sync_nz() -> void {}
+#endif
+    auto set_nz_flags(bool n, bool z) -> void { // n/z 不由同一个结果决定时直接写入
+        r_stat_.N = n;
+        r_stat_.Z = z;
+        nz_lazy_ = false;
+    }
+    auto step() -> uint8_t; // 执行一条指令，返回消耗的周期数
+    auto run_threaded() -> void;
+    auto run_blocks() -> void;
+    auto translate(uint16_t addr) -> const code_block &;
+    auto decode_at(uint16_t pc) -> decoded_inst;     // 译码 pc 处的指令
+    auto decoded(uint16_t pc) -> const decoded_inst *; // 缓存的译码结果，不可缓存的地址返回 nullptr
+    auto run_block(const code_block &blk) -> uint32_t; // 返回执行的指令数
+    auto run_checked(const code_block &blk) -> void;
+    auto lockstep_read(uint16_t addr) -> uint8_t;
+    auto lockstep_write(uint16_t addr, uint8_t data) -> void;
+    auto run_aot() -> void;
+    auto skip_idle() -> void;                         // 向后跳转后调用，跳过空转直到 deadline_ 之前
+    auto idle_verdict(uint16_t head) -> uint32_t;     // 同 idle_loop_cycles，prg rom 中的目标使用缓存的结论
+    auto idle_loop_cycles(uint16_t head) -> uint32_t; // head 处空转循环一次迭代的周期数，不是空转循环返回 0
 
     // 寄存器
   public:
@@ -157,29 +327,130 @@ class cpu {
     auto y() -> uint8_t { return r_y_; }
     auto sp() -> uint8_t { return r_sp_; }
     auto pc() -> uint16_t { return r_pc_; }
-    auto stat() -> status_register { return r_stat_; }
+    auto stat() -> status_register {
+        sync_nz();
+        return r_stat_;
+    }
+    auto clocks() -> uint64_t { return clocks_; }
+    auto mode() -> dispatch_mode { return mode_; } // 实际使用的执行方式，不支持时已退回 threaded
+    auto cycles_left() -> uint8_t { return cycles_; } // next_clock 逐周期执行时当前指令剩余的周期
+    auto check_errors() -> uint32_t { return check_errors_; }
+    auto skipped_cycles() -> uint64_t { return skipped_cycles_; }
 
     // 辅助函数
   public:
-    static auto inst_len(const instruction &inst) -> int;           // 指令长度
+    template <uint8_t Op>
+    static auto op(basic_cpu &c) -> uint8_t;                        // 执行操作码 Op，pc 指向操作数，返回消耗的周期数
+    template <uint8_t Op>
+    static auto aot_op(basic_cpu &c, uint16_t pc) -> void {         // 预编译代码执行一条指令，pc 指向操作数
+        c.r_pc_ = pc;
+        c.clocks_ += op<Op>(c);
+    }
+    static auto inst_len(uint8_t opcode) -> int;                    // 指令长度
     static auto inst_str(uint8_t *mem, uint16_t pc) -> std::string; // 指令字符串
 
   private:
-    bus &bus_;
-    uint32_t clocks_{}; // 时钟周期计数
-    uint8_t cycles_{};  // 当前指令剩余执行周期
-    uint8_t opcode_{};  // 当前指令
-    uint8_t fetched_{}; // 读取的数据
-    uint16_t addr_{};   // 地址
-    int8_t off_{};      // 偏移
+    Bus &bus_;
+    dispatch_mode mode_;
+    uint64_t clocks_{};   // 时钟周期计数，批量执行期间为当前指令开始的时刻
+    uint64_t deadline_{}; // 本次批量执行的截止时刻
+    uint8_t cycles_{};    // 当前指令剩余执行周期
+    uint8_t opcode_{};    // 当前指令
+    uint8_t fetched_{};   // 读取的数据
+    uint16_t addr_{};     // 地址
+    int8_t off_{};        // 偏移
+    uint8_t nz_{};        // 最后一次影响 n/z 的结果
+    bool nz_lazy_{};      // n/z 尚未从 nz_ 计算
+
+    // 基本块翻译
+  private:
+    std::vector<code_block> blocks_;  // 已翻译的基本块
+    std::vector<uint16_t> block_idx_; // 0x8000 ~ 0xffff 每个地址对应的块下标 + 1，0 表示未翻译
+    bool code_dirty_{};               // 执行块期间有代码被修改
+    uint32_t check_errors_{};         // checked 模式下发现的不一致次数
+    uint64_t stalled_{};              // stall 累计的周期数
+    aot_entry aot_{};                 // 预编译代码入口
+
+    // lockstep 比较
+  private:
+    enum class lockstep : uint8_t {
+        off,
+        record, // 执行块，记录数据访存
+        replay, // 解释器重新执行，读取回放记录的值，写入只与记录比较
+    };
+    struct mem_access {
+        uint16_t addr;
+        uint8_t data;
+        bool write;
+        auto operator==(const mem_access &) const -> bool = default;
+    };
+    // 比较的状态，标志已经同步
+    struct cpu_state {
+        uint8_t a, x, y, sp, stat;
+        uint16_t pc;
+        auto operator==(const cpu_state &) const -> bool = default;
+    };
+    auto save_state() -> cpu_state;
+    auto load_state(const cpu_state &s) -> void;
+
+    lockstep lockstep_{lockstep::off};
+    std::vector<mem_access> accesses_; // 块执行期间的数据访存
+    size_t replay_pos_{};              // 回放到的位置
+    bool replay_diverged_{};           // 解释器的访存与记录不一致
+
+    // 译码缓存
+  private:
+    std::vector<decoded_inst> rom_cache_; // 0x8000 ~ 0xffff
+    std::vector<decoded_inst> ram_cache_; // 0x0000 ~ 0x07ff，包含镜像
+    uint8_t ram_code_pages_{};            // ram 中缓存过代码的页
+
+    // 空转循环检测
+  private:
+    uint16_t idle_pc_{};        // 最近一次向后跳转的目标
+    bool idle_known_{};         // idle_pc_ 已分析
+    bool idle_seen_{};          // 已记录到达 idle_pc_ 时的状态
+    uint32_t idle_period_{};    // 一次迭代的周期数，0 表示不是空转循环
+    uint64_t idle_clocks_{};    // 上次到达 idle_pc_ 时的周期数
+    uint64_t idle_regs_{};      // 上次到达 idle_pc_ 时的寄存器与标志
+    uint64_t skipped_cycles_{}; // 累计跳过的周期数
+    std::unordered_map<uint16_t, uint32_t> idle_verdicts_; // prg rom 中分析过的目标 → idle_loop_cycles 的结果
 
   public:
-    const static std::vector<instruction> inst_table; // 指令表
+    const static std::array<instruction, 256> inst_table; // 指令表，执行时使用
+    const static std::array<inst_info, 256> inst_infos;   // 指令信息，反汇编时使用
+    const static std::array<decoded_handler, 256> decoded_table; // 预译码指令的处理函数
+};
+
+template <typename Cpu>
+struct basic_instruction {
+    void (*exec)(Cpu &){}; // 处理函数
+    addr_mode mod{};       // 寻址模式
+    uint8_t cycles{};      // 执行周期
+    uint8_t len{};         // 指令长度
+};
+
+struct inst_info {
+    std::string_view name; // 助记符
+    bool ends_block{};     // 是否会改变 pc 或解除中断屏蔽，结束一个基本块
+    bool idle_safe{};      // 不写内存、不改变栈，可以出现在空转循环中
+};
+
+// 预译码的指令
+template <typename Cpu>
+struct basic_decoded_inst {
+    void (*exec)(Cpu &, uint16_t){}; // 处理函数，为空表示未译码
+    uint16_t operand{};              // 基础有效地址：立即数为其地址，其他为指令中的操作数
+    uint8_t opcode{};                // 操作码
+    uint8_t len{};                   // 指令长度
+    uint8_t cycles{};                // 执行周期
 };
 
-struct instruction {
-    std::string name;     // 助记符
-    cpu::opt_type opt{};  // 操作
-    cpu::addr_mode mod{}; // 寻址模式
-    uint8_t cycles{};     // 执行周期
+// 翻译后的基本块，以跳转、分支、返回或未知指令结尾
+template <typename Cpu>
+struct basic_code_block {
+    uint16_t start{};   // 起始地址
+    uint16_t last{};    // 最后一个字节的地址
+    uint32_t cycles{};  // 基础周期数之和
+    bool valid{};       // 是否有效
+    std::vector<basic_decoded_inst<Cpu>> ops{};
 };
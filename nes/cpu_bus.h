@@ -0,0 +1,18 @@
+#pragma once
+#include "cpu.h"
+#include <array>
+#include <cstdint>
+
+// 64KB 平坦内存，没有镜像和 io 寄存器，用于运行 cpu 的功能测试（Klaus Dormann、Tom Harte 等）
+class cpu_bus {
+  public:
+    auto cpu_bus_write(uint16_t addr, uint8_t data) -> void { mem_[addr] = data; }
+    auto cpu_bus_read(uint16_t addr) -> uint8_t { return mem_[addr]; }
+
+    auto ram() -> uint8_t * { return mem_.data(); }
+
+  private:
+    std::array<uint8_t, 64 * 1024> mem_{};
+};
+
+extern template class basic_cpu<cpu_bus>;
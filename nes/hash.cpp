@@ -0,0 +1,116 @@
+#include "hash.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+// tables[k][b] 为字节 b 之后再经过 k 个零字节的 crc，8 张表一次处理 8 个字节
+constexpr auto crc_tables = [] {
+    auto t = std::array<std::array<uint32_t, 256>, 8>{};
+    for (auto i = 0u; i < 256; ++i) {
+        auto c = i;
+        for (auto k = 0; k < 8; ++k) {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        t[0][i] = c;
+    }
+    for (auto i = 0u; i < 256; ++i) {
+        for (auto k = 1; k < 8; ++k) {
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+        }
+    }
+    return t;
+}();
+
+auto load_le32(const uint8_t *p) -> uint32_t {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+auto load_be32(const uint8_t *p) -> uint32_t {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+} // namespace
+
+auto crc32(std::span<const uint8_t> data, uint32_t crc) -> uint32_t {
+    const auto &t = crc_tables;
+    auto p = data.data();
+    auto n = data.size();
+    crc = ~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        const auto lo = load_le32(p) ^ crc;
+        const auto hi = load_le32(p + 4);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; n > 0; ++p, --n) {
+        crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+auto sha1::update(std::span<const uint8_t> data) -> void {
+    auto used = static_cast<size_t>(len_ % 64);
+    len_ += data.size();
+    if (used) { // 先补齐上次剩下的块
+        const auto n = std::min(64 - used, data.size());
+        std::memcpy(buf_.data() + used, data.data(), n);
+        data = data.subspan(n);
+        if (used + n < 64) {
+            return;
+        }
+        compress(buf_.data());
+    }
+    for (; data.size() >= 64; data = data.subspan(64)) {
+        compress(data.data());
+    }
+    std::memcpy(buf_.data(), data.data(), data.size());
+}
+
+auto sha1::finish() -> digest {
+    const auto bits = len_ * 8;
+    auto pad = std::array<uint8_t, 72>{0x80};
+    const auto used = static_cast<size_t>(len_ % 64);
+    const auto n = (used < 56 ? 56 : 120) - used; // 填充到长度字段之前
+    for (auto i = 0; i < 8; ++i) {
+        pad[n + i] = static_cast<uint8_t>(bits >> (56 - i * 8));
+    }
+    update({pad.data(), n + 8});
+
+    auto d = digest{};
+    for (auto i = 0; i < 5; ++i) {
+        d[i * 4 + 0] = static_cast<uint8_t>(h_[i] >> 24);
+        d[i * 4 + 1] = static_cast<uint8_t>(h_[i] >> 16);
+        d[i * 4 + 2] = static_cast<uint8_t>(h_[i] >> 8);
+        d[i * 4 + 3] = static_cast<uint8_t>(h_[i]);
+    }
+    return d;
+}
+
+auto sha1::compress(const uint8_t *block) -> void {
+    auto w = std::array<uint32_t, 80>{};
+    for (auto i = 0; i < 16; ++i) {
+        w[i] = load_be32(block + i * 4);
+    }
+    for (auto i = 16; i < 80; ++i) {
+        w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    auto [a, b, c, d, e] = h_;
+    for (auto i = 0; i < 80; ++i) {
+        auto f = uint32_t{}, k = uint32_t{};
+        if (i < 20) {
+            f = (b & c) | (~b & d), k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d, k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d), k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d, k = 0xca62c1d6;
+        }
+        const auto t = std::rotl(a, 5) + f + e + k + w[i];
+        e = d, d = c, c = std::rotl(b, 30), b = a, a = t;
+    }
+    h_[0] += a, h_[1] += b, h_[2] += c, h_[3] += d, h_[4] += e;
+}
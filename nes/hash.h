@@ -0,0 +1,25 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+
+// crc32（ieee 802.3，与 zip、nes 数据库使用的相同），按 8 字节查表计算。
+// crc 为上一段数据的结果，分段计算时依次传入
+auto crc32(std::span<const uint8_t> data, uint32_t crc = 0) -> uint32_t;
+
+// sha-1，可以分段输入
+class sha1 {
+  public:
+    using digest = std::array<uint8_t, 20>;
+
+    auto update(std::span<const uint8_t> data) -> void;
+    auto finish() -> digest; // 之后不能再输入
+
+  private:
+    auto compress(const uint8_t *block) -> void;
+
+  private:
+    std::array<uint32_t, 5> h_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    std::array<uint8_t, 64> buf_{};
+    uint64_t len_{}; // 已输入的字节数
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include "rom_image.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+// 头部错误的 rom 的修正项，未填写的字段保持头部中的值
+struct header_fixup {
+    uint32_t crc{}; // prg rom 与 chr rom 连在一起的 crc32，与 nes 2.0 数据库相同
+    std::optional<uint16_t> mapper{};
+    std::optional<uint8_t> submapper{};
+    std::optional<mirroring> mirror{};
+    std::optional<uint32_t> prg_ram_size{};   // 易失 prg ram 的字节数
+    std::optional<uint32_t> prg_nvram_size{}; // 电池供电 prg ram 的字节数
+    std::optional<tv_system> timing{};
+};
+
+// 按 crc 升序排列，加载时二分查找，增加条目时同时修改数组长度。
+// 条目应来自核对过的数据库（如 nes 2.0 数据库），不要根据文件名或猜测添加：
+//     {.crc = 0x........, .mapper = 4, .mirror = mirroring::vertical},
+inline constexpr auto header_fixups = std::array<header_fixup, 0>{{
+}};
+
+static_assert(std::ranges::is_sorted(header_fixups, {}, &header_fixup::crc), "header_fixups 必须按 crc 排序");
+
+// table 必须按 crc 升序排列，测试可以传入自己的表
+constexpr auto find_header_fixup(uint32_t crc, std::span<const header_fixup> table = header_fixups)
+    -> const header_fixup * {
+    const auto it = std::ranges::lower_bound(table, crc, {}, &header_fixup::crc);
+    return it != table.end() && it->crc == crc ? &*it : nullptr;
+}
+
+// 用修正项覆盖 info 中对应的字段，只有修正了 prg nvram 大小时才重新决定是否有电池
+constexpr auto apply_header_fixup(rom_info &i, const header_fixup &f) -> void {
+    i.fixed = true;
+    i.mapper = f.mapper.value_or(i.mapper);
+    i.submapper = f.submapper.value_or(i.submapper);
+    i.mirror = f.mirror.value_or(i.mirror);
+    i.prg_ram_size = f.prg_ram_size.value_or(i.prg_ram_size);
+    if (f.prg_nvram_size) {
+        i.prg_nvram_size = *f.prg_nvram_size;
+        i.battery = i.prg_nvram_size != 0;
+    }
+    i.timing = f.timing.value_or(i.timing);
+}
@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+mapped_file::mapped_file(const std::string &filename) {
+    const auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    auto size = LARGE_INTEGER{};
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) {
+            data_ = static_cast<const uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+            size_ = data_ ? static_cast<size_t>(size.QuadPart) : 0;
+        }
+    }
+    CloseHandle(file); // 映射对象持有文件的引用
+}
+
+auto mapped_file::close() -> void {
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapping_ = nullptr;
+}
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+      mapping_(std::exchange(other.mapping_, nullptr)) {}
+
+auto mapped_file::operator=(mapped_file &&other) noexcept -> mapped_file & {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+    }
+    return *this;
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(const std::string &filename) {
+    const auto fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        const auto size = static_cast<size_t>(st.st_size);
+        const auto p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data_ = static_cast<const uint8_t *>(p);
+            size_ = size;
+        }
+    }
+    ::close(fd); // 映射建立后不再需要文件描述符
+}
+
+auto mapped_file::close() -> void {
+    if (data_) {
+        ::munmap(const_cast<uint8_t *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+auto mapped_file::operator=(mapped_file &&other) noexcept -> mapped_file & {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+#endif
+
+mapped_file::~mapped_file() {
+    close();
+}
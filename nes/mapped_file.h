@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+
+// 以只读方式映射到内存的文件，数据由操作系统按页载入，不复制到进程的堆上
+class mapped_file {
+  public:
+    mapped_file() = default;
+    explicit mapped_file(const std::string &filename);
+    mapped_file(mapped_file &&other) noexcept;
+    auto operator=(mapped_file &&other) noexcept -> mapped_file &;
+    mapped_file(const mapped_file &) = delete;
+    auto operator=(const mapped_file &) -> mapped_file & = delete;
+    ~mapped_file();
+
+    auto valid() const -> bool { return data_ != nullptr; }
+    auto data() const -> std::span<const uint8_t> { return {data_, size_}; }
+    auto size() const -> size_t { return size_; }
+
+  private:
+    auto close() -> void;
+
+  private:
+    const uint8_t *data_{};
+    size_t size_{};
+#ifdef _WIN32
+    void *mapping_{}; // CreateFileMapping 返回的句柄
+#endif
+};
@@ -0,0 +1,169 @@
+#include "mapper.h"
+
+auto nrom::reset(mapper_banks &b) -> void {
+    b.map_prg_16k(0, 0);
+    b.map_prg_16k(1, -1); // 16KB 的 prg rom 在 0xc000 处镜像
+    b.map_chr_8k(0);
+}
+
+auto uxrom::reset(mapper_banks &b) -> void {
+    b.map_prg_16k(0, 0);
+    b.map_prg_16k(1, -1);
+    b.map_chr_8k(0);
+}
+
+auto uxrom::write(mapper_banks &b, uint16_t /*addr*/, uint8_t data) -> void {
+    b.map_prg_16k(0, data);
+}
+
+auto cnrom::reset(mapper_banks &b) -> void {
+    b.map_prg_16k(0, 0);
+    b.map_prg_16k(1, -1);
+    b.map_chr_8k(0);
+}
+
+auto cnrom::write(mapper_banks &b, uint16_t /*addr*/, uint8_t data) -> void {
+    b.map_chr_8k(data);
+}
+
+auto axrom::reset(mapper_banks &b) -> void {
+    b.map_prg_32k(0);
+    b.map_chr_8k(0);
+    b.mirror = mirroring::single_lo;
+}
+
+auto axrom::write(mapper_banks &b, uint16_t /*addr*/, uint8_t data) -> void {
+    b.map_prg_32k(data & 0x7);
+    b.mirror = data & 0x10 ? mirroring::single_hi : mirroring::single_lo;
+}
+
+auto mmc1::reset(mapper_banks &b) -> void {
+    shift_ = 0x10;
+    control_ = 0x0c;
+    apply(b);
+}
+
+// 每次写入移入 data 的最低位，第 5 次写入时按地址写入对应的寄存器；最高位为 1 时复位
+auto mmc1::write(mapper_banks &b, uint16_t addr, uint8_t data) -> void {
+    if (data & 0x80) {
+        shift_ = 0x10;
+        control_ |= 0x0c;
+        apply(b);
+        return;
+    }
+    const auto done = shift_ & 0x1;
+    shift_ = (shift_ >> 1) | ((data & 0x1) << 4);
+    if (!done) {
+        return;
+    }
+    switch ((addr >> 13) & 0x3) {
+        case 0:
+            control_ = shift_;
+            break;
+        case 1:
+            chr0_ = shift_;
+            break;
+        case 2:
+            chr1_ = shift_;
+            break;
+        case 3:
+            prg_ = shift_;
+            break;
+    }
+    shift_ = 0x10;
+    apply(b);
+}
+
+auto mmc1::apply(mapper_banks &b) -> void {
+    constexpr mirroring mirrors[] = {mirroring::single_lo, mirroring::single_hi, mirroring::vertical, mirroring::horizontal};
+    b.mirror = mirrors[control_ & 0x3];
+    if (control_ & 0x10) { // 两个 4KB chr bank
+        b.map_chr_4k(0, chr0_);
+        b.map_chr_4k(1, chr1_);
+    } else { // 一个 8KB chr bank，忽略最低位
+        b.map_chr_8k(chr0_ >> 1);
+    }
+    const auto bank = prg_ & 0xf;
+    switch ((control_ >> 2) & 0x3) {
+        case 0:
+        case 1: // 32KB，忽略最低位
+            b.map_prg_32k(bank >> 1);
+            break;
+        case 2: // 0x8000 固定为第一个 bank
+            b.map_prg_16k(0, 0);
+            b.map_prg_16k(1, bank);
+            break;
+        case 3: // 0xc000 固定为最后一个 bank
+            b.map_prg_16k(0, bank);
+            b.map_prg_16k(1, -1);
+            break;
+    }
+}
+
+auto mmc3::reset(mapper_banks &b) -> void {
+    select_ = 0;
+    r_ = {0, 2, 4, 5, 6, 7, 0, 1};
+    apply(b);
+}
+
+// 0x8000 ~ 0xffff 每 8KB 两个寄存器，按地址奇偶区分
+auto mmc3::write(mapper_banks &b, uint16_t addr, uint8_t data) -> void {
+    const auto odd = addr & 0x1;
+    switch ((addr >> 13) & 0x3) {
+        case 0:
+            if (odd) {
+                r_[select_ & 0x7] = data;
+            } else {
+                select_ = data;
+            }
+            apply(b);
+            break;
+        case 1:
+            if (!odd && b.mirror != mirroring::four_screen) {
+                b.mirror = data & 0x1 ? mirroring::horizontal : mirroring::vertical;
+            }
+            break;
+        case 2:
+            if (odd) {
+                irq_counter_ = 0;
+                irq_reload_ = true;
+            } else {
+                irq_latch_ = data;
+            }
+            break;
+        case 3:
+            irq_enabled_ = odd;
+            if (!odd) {
+                b.irq = false; // 关闭时同时确认中断
+            }
+            break;
+    }
+}
+
+auto mmc3::scanline(mapper_banks &b) -> void {
+    if (irq_counter_ == 0 || irq_reload_) {
+        irq_counter_ = irq_latch_;
+        irq_reload_ = false;
+    } else {
+        --irq_counter_;
+    }
+    if (irq_counter_ == 0 && irq_enabled_) {
+        b.irq = true;
+    }
+}
+
+auto mmc3::apply(mapper_banks &b) -> void {
+    // chr 模式为 1 时 2KB 与 1KB 的区域交换
+    const auto inv = (select_ & 0x80) ? 4 : 0;
+    b.map_chr_2k((0 ^ inv) / 2, r_[0] >> 1);
+    b.map_chr_2k((2 ^ inv) / 2, r_[1] >> 1);
+    for (auto i = 0; i < 4; ++i) {
+        b.map_chr_1k((4 + i) ^ inv, r_[2 + i]);
+    }
+    // prg 模式为 1 时 0x8000 与 0xc000 交换，固定的一侧为倒数第二个 bank
+    const auto swap = (select_ & 0x40) != 0;
+    b.map_prg_8k(swap ? 2 : 0, r_[6]);
+    b.map_prg_8k(1, r_[7]);
+    b.map_prg_8k(swap ? 0 : 2, -2);
+    b.map_prg_8k(3, -1);
+}
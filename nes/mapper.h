@@ -0,0 +1,142 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <variant>
+
+// 名称表镜像方式
+enum class mirroring : uint8_t {
+    horizontal,
+    vertical,
+    single_lo, // 只使用第一个名称表
+    single_hi, // 只使用第二个名称表
+    four_screen,
+};
+
+// prg 按 8KB、chr 按 1KB 划分窗口，切换 bank 只修改窗口指针，不复制数据
+struct mapper_banks {
+    std::span<const uint8_t> prg_rom;     // 卡带的全部 prg rom
+    std::span<const uint8_t> chr_mem;     // 卡带的全部 chr rom 或 chr ram
+    std::array<const uint8_t *, 4> prg{}; // 0x8000、0xa000、0xc000、0xe000
+    std::array<const uint8_t *, 8> chr{}; // 0x0000 ~ 0x1fff，每 1KB 一个窗口
+    mirroring mirror{};                   // 名称表镜像方式
+    bool chr_writable{};                  // chr ram
+    bool irq{};                           // mapper 请求中断
+
+    auto prg_count() -> int { return static_cast<int>(prg_rom.size() / 0x2000); } // 8KB bank 数
+    auto chr_count() -> int { return static_cast<int>(chr_mem.size() / 0x400); }  // 1KB bank 数
+
+    // bank 可以为负数，表示从末尾开始计数，超出范围时按 bank 数取模
+    auto map_prg_8k(int slot, int bank) -> void {
+        const auto n = prg_count();
+        if (n == 0) {
+            return;
+        }
+        prg[slot] = prg_rom.data() + ((bank % n + n) % n) * 0x2000;
+    }
+    auto map_prg_16k(int slot, int bank) -> void {
+        map_prg_8k(slot * 2, bank * 2);
+        map_prg_8k(slot * 2 + 1, bank * 2 + 1);
+    }
+    auto map_prg_32k(int bank) -> void {
+        map_prg_16k(0, bank * 2);
+        map_prg_16k(1, bank * 2 + 1);
+    }
+    auto map_chr_1k(int slot, int bank) -> void {
+        const auto n = chr_count();
+        if (n == 0) {
+            return;
+        }
+        chr[slot] = chr_mem.data() + ((bank % n + n) % n) * 0x400;
+    }
+    auto map_chr_2k(int slot, int bank) -> void {
+        map_chr_1k(slot * 2, bank * 2);
+        map_chr_1k(slot * 2 + 1, bank * 2 + 1);
+    }
+    auto map_chr_4k(int slot, int bank) -> void {
+        map_chr_2k(slot * 2, bank * 2);
+        map_chr_2k(slot * 2 + 1, bank * 2 + 1);
+    }
+    auto map_chr_8k(int bank) -> void {
+        map_chr_4k(0, bank * 2);
+        map_chr_4k(1, bank * 2 + 1);
+    }
+};
+
+// 各 mapper 只实现寄存器逻辑，存储由 mapper_banks 的窗口完成
+// reset 设置上电时的 bank，write 处理 0x8000 ~ 0xffff 的写入，scanline 在每条扫描线结束时调用
+
+// mapper 0
+struct nrom {
+    static constexpr bool fixed_prg = true;
+    auto reset(mapper_banks &b) -> void;
+    auto write(mapper_banks & /*b*/, uint16_t /*addr*/, uint8_t /*data*/) -> void {}
+    auto scanline(mapper_banks & /*b*/) -> void {}
+};
+
+// mapper 2，0xc000 固定为最后一个 16KB bank
+struct uxrom {
+    auto reset(mapper_banks &b) -> void;
+    auto write(mapper_banks &b, uint16_t addr, uint8_t data) -> void;
+    auto scanline(mapper_banks & /*b*/) -> void {}
+};
+
+// mapper 3，只切换 8KB chr
+struct cnrom {
+    static constexpr bool fixed_prg = true;
+    auto reset(mapper_banks &b) -> void;
+    auto write(mapper_banks &b, uint16_t addr, uint8_t data) -> void;
+    auto scanline(mapper_banks & /*b*/) -> void {}
+};
+
+// mapper 7，32KB prg 与单屏镜像
+struct axrom {
+    auto reset(mapper_banks &b) -> void;
+    auto write(mapper_banks &b, uint16_t addr, uint8_t data) -> void;
+    auto scanline(mapper_banks & /*b*/) -> void {}
+};
+
+// mapper 1，串行写入的 5 位寄存器
+struct mmc1 {
+    auto reset(mapper_banks &b) -> void;
+    auto write(mapper_banks &b, uint16_t addr, uint8_t data) -> void;
+    auto scanline(mapper_banks & /*b*/) -> void {}
+
+  private:
+    auto apply(mapper_banks &b) -> void;
+
+    uint8_t shift_{0x10}; // 移位寄存器，最高位的 1 到达最低位时写入完成
+    uint8_t control_{0x0c};
+    uint8_t chr0_{};
+    uint8_t chr1_{};
+    uint8_t prg_{};
+};
+
+// mapper 4，8 个 bank 寄存器与扫描线计数中断
+struct mmc3 {
+    static constexpr bool counts_scanlines = true;
+    auto reset(mapper_banks &b) -> void;
+    auto write(mapper_banks &b, uint16_t addr, uint8_t data) -> void;
+    auto scanline(mapper_banks &b) -> void;
+
+  private:
+    auto apply(mapper_banks &b) -> void;
+
+    uint8_t select_{};           // 0x8000，低 3 位选择 r_，第 6、7 位为 prg、chr 模式
+    std::array<uint8_t, 8> r_{}; // r0 ~ r7
+    uint8_t irq_latch_{};        // 0xc000
+    uint8_t irq_counter_{};      // 每条扫描线减一，到 0 时重新载入
+    bool irq_reload_{};          // 0xc001
+    bool irq_enabled_{};         // 0xe000 关闭，0xe001 开启
+};
+
+// prg bank 固定，写入寄存器后不需要重新映射 prg
+template <typename M>
+concept fixed_prg_mapper = M::fixed_prg;
+
+// 需要扫描线计数，调度器只为这些 mapper 安排扫描线事件
+template <typename M>
+concept scanline_mapper = M::counts_scanlines;
+
+// 寄存器写入很少，通过 std::visit 分派；读取只经过 mapper_banks 的窗口指针
+using mapper = std::variant<nrom, uxrom, cnrom, axrom, mmc1, mmc3>;
@@ -1,5 +1,56 @@
-#include "bus.h"
-#include <utility>
+#include "ppu.h"
+#include "bg_row.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// 精细 y 溢出时粗略 y 加一，到 29 时切换到垂直相邻的名称表
+auto next_line(uint16_t v) -> uint16_t {
+    if ((v & 0x7000) != 0x7000) {
+        return v + 0x1000;
+    }
+    v &= ~0x7000;
+    auto y = (v & 0x03e0) >> 5;
+    if (y == 29) {
+        y = 0;
+        v ^= 0x0800;
+    } else if (y == 31) {
+        y = 0;
+    } else {
+        ++y;
+    }
+    return (v & ~0x03e0) | (y << 5);
+}
+
+} // namespace
+
+auto ppu::connect(cartridge *cart, uint8_t *vram) -> void {
+    cart_ = cart && cart->valid() ? cart : nullptr;
+    vram_ = vram;
+}
+
+auto ppu::reset_timing(const clock_timing &timing, uint64_t frame_start) -> void {
+    timing_ = &timing;
+    clock_ = frame_start;
+    line_ = 0;
+    dot_ = 0;
+    odd_ = false;
+    short_frame_ = false;
+}
+
+auto ppu::run_to(uint64_t time) -> void {
+    while (clock_ <= time) {
+        if (skip_idle(time)) {
+            continue;
+        }
+        if (render_ == ppu_render::scanline && draw_line()) {
+            continue;
+        }
+        tick();
+        advance(1);
+    }
+}
 
 // control      0    w
 // mask         1    w
@@ -9,30 +60,51 @@
 // scroll       5    w
 // addr         6    w
 // data         7    rw
-auto ppu::cpu_bus_read(uint16_t addr) -> uint8_t {
+// 轮询 $2002 时只要预测的下一次状态变化还没到，就不需要追赶
+auto ppu::cpu_bus_read(uint16_t addr, uint64_t time) -> uint8_t {
+    if ((addr & 0x7) == 2) {
+        if (!predicted_ || clock_ > status_change_) {
+            predict();
+        }
+        if (time >= status_change_) {
+            run_to(time);
+        }
+    } else {
+        run_to(time);
+    }
     switch (addr & 0x7) {
-        case 0:
-        case 1:
-            return 0;
-        case 2:
-            return *reinterpret_cast<uint8_t *>(&r_stat_);
-        case 3:
-            return 0;
+        case 2: {
+            const auto stat = *reinterpret_cast<uint8_t *>(&r_stat_);
+            r_stat_.v_blank = 0; // 读取后清除 vblank
+            w_ = false;
+            return stat;
+        }
         case 4:
             return reinterpret_cast<uint8_t *>(oam_)[oam_addr_];
-        case 5:
-        case 6:
+        case 7: {
+            // 名称表与图案的读取延迟一次，调色板直接返回，同时缓冲其下方的名称表
+            auto data = read_buffer_;
+            read_buffer_ = ppu_bus_read(v_);
+            if ((v_ & 0x3fff) >= 0x3f00) {
+                data = palette(v_);
+                read_buffer_ = ppu_bus_read(v_ - 0x1000);
+            }
+            v_ = (v_ + (r_ctrl_.vram_inc ? 32 : 1)) & 0x7fff;
+            set_a12(v_ & 0x1000);
+            return data;
+        }
+        default:
             return 0;
-        case 7:
-            // todo))
     }
-    std::unreachable();
 }
 
-auto ppu::cpu_bus_write(uint16_t addr, uint8_t data) -> void {
+auto ppu::cpu_bus_write(uint16_t addr, uint8_t data, uint64_t time) -> void {
+    run_to(time);
+    predicted_ = false;
     switch (addr & 0x7) {
         case 0:
             *reinterpret_cast<uint8_t *>(&r_ctrl_) = data;
+            t_ = (t_ & ~0x0c00) | ((data & 0x3) << 10);
             break;
         case 1:
             *reinterpret_cast<uint8_t *>(&r_mask_) = data;
@@ -43,15 +115,538 @@ auto ppu::cpu_bus_write(uint16_t addr, uint8_t data) -> void {
             oam_addr_ = data;
             break;
         case 4:
-            reinterpret_cast<uint8_t *>(oam_)[oam_addr_] = data;
+            reinterpret_cast<uint8_t *>(oam_)[oam_addr_++] = data;
             break;
         case 5:
-            r_scroll_ = data;
+            if (!w_) {
+                t_ = (t_ & ~0x001f) | (data >> 3);
+                fine_x_ = data & 0x7;
+            } else {
+                t_ = (t_ & ~0x73e0) | ((data & 0x7) << 12) | ((data & 0xf8) << 2);
+            }
+            w_ = !w_;
+            break;
+        case 6:
+            if (!w_) {
+                t_ = (t_ & 0x00ff) | ((data & 0x3f) << 8);
+            } else {
+                t_ = (t_ & 0xff00) | data;
+                v_ = t_;
+                set_a12(v_ & 0x1000);
+            }
+            w_ = !w_;
+            break;
+        case 7:
+            ppu_bus_write(v_, data);
+            v_ = (v_ + (r_ctrl_.vram_inc ? 32 : 1)) & 0x7fff;
+            set_a12(v_ & 0x1000);
+            break;
+    }
+}
+
+// 0x0000 ~ 0x1fff  图案表，来自卡带
+// 0x2000 ~ 0x3eff  名称表，按卡带的镜像方式映射到 2KB vram
+// 0x3f00 ~ 0x3fff  调色板
+auto ppu::ppu_bus_read(uint16_t addr) -> uint8_t {
+    addr &= 0x3fff;
+    if (addr < 0x2000) {
+        return cart_ ? cart_->chr_read(addr) : 0;
+    }
+    if (addr < 0x3f00) {
+        return nametable(addr);
+    }
+    return palette(addr);
+}
+
+auto ppu::ppu_bus_write(uint16_t addr, uint8_t data) -> void {
+    addr &= 0x3fff;
+    if (addr < 0x2000) {
+        if (cart_) {
+            cart_->chr_write(addr, data);
+        }
+    } else if (addr < 0x3f00) {
+        nametable(addr) = data;
+    } else {
+        palette(addr) = data & 0x3f;
+    }
+}
+
+// 四屏需要卡带上额外的 vram，这里按垂直镜像处理
+auto ppu::nametable(uint16_t addr) -> uint8_t & {
+    const auto table = (addr >> 10) & 0x3;
+    auto bank = table >> 1;
+    switch (cart_ ? cart_->mirror() : mirroring::horizontal) {
+        case mirroring::horizontal:
+            bank = table >> 1;
+            break;
+        case mirroring::vertical:
+        case mirroring::four_screen:
+            bank = table & 1;
+            break;
+        case mirroring::single_lo:
+            bank = 0;
+            break;
+        case mirroring::single_hi:
+            bank = 1;
+            break;
+    }
+    return vram_[(bank << 10) | (addr & 0x3ff)];
+}
+
+// 0x3f10、0x3f14、0x3f18、0x3f1c 是背景对应项的镜像
+auto ppu::palette(uint16_t addr) -> uint8_t & {
+    addr &= 0x1f;
+    if ((addr & 0x13) == 0x10) {
+        addr &= 0x0f;
+    }
+    return palette_ram_idx_[addr];
+}
+
+auto ppu::oam_dma(const uint8_t *page) -> void {
+    predicted_ = false;
+    auto *oam = reinterpret_cast<uint8_t *>(oam_);
+    for (auto i = 0; i < 256; ++i) {
+        oam[static_cast<uint8_t>(oam_addr_ + i)] = page[i];
+    }
+}
+
+// 与 nesdev wiki 上的帧时序图对应：可见行与预渲染行取背景与 sprite，241 行第 1 点进入 vblank，
+// 预渲染行第 1 点清除状态标志
+auto ppu::tick() -> void {
+    const auto pre = line_ == timing_->prerender_line();
+    if (line_ >= 240 && !pre) {
+        if (line_ == clock_timing::vblank_line && dot_ == 1) {
+            r_stat_.v_blank = 1;
+        }
+        return;
+    }
+    if (pre && dot_ == 1) {
+        r_stat_.v_blank = 0;
+        r_stat_.sp_zero_hint = 0;
+        r_stat_.sp_overflow = 0;
+        short_frame_ = timing_->odd_frame_skip && odd_ && rendering();
+        predicted_ = false;
+    }
+    if (rendering()) {
+        if ((dot_ >= 2 && dot_ < 258) || (dot_ >= 321 && dot_ < 338)) {
+            fetch_bg();
+        }
+        if (dot_ == 256) {
+            inc_y();
+        } else if (dot_ == 257) {
+            copy_x();
+            line_h_ = v_ & 0x041f;
+            if (pre) {
+                sprite_count_ = 0;
+            } else {
+                evaluate_sprites();
+            }
+        } else if (pre && dot_ >= 280 && dot_ <= 304) {
+            copy_y();
+        } else if (dot_ == 260) {
+            set_a12(r_ctrl_.sprite_size || r_ctrl_.sprite_table_addr); // 8x16 时空闲的 sprite 取 $ff 号图块
+        } else if (dot_ == 324) {
+            set_a12(r_ctrl_.bg_table_addr);
+        }
+    }
+    if (!pre && dot_ >= 1 && dot_ <= 256) {
+        render_pixel(dot_ - 1);
+    }
+}
+
+// 预渲染行最后一点被跳过时直接进入下一帧
+auto ppu::advance(uint32_t n) -> void {
+    clock_ += uint64_t{n} * timing_->ppu_div;
+    dot_ += n;
+    if (short_frame_ && dot_ == 340 && line_ == timing_->prerender_line()) {
+        dot_ = clock_timing::dots;
+    }
+    while (dot_ >= clock_timing::dots) {
+        dot_ -= clock_timing::dots;
+        if (++line_ > timing_->prerender_line()) {
+            line_ = 0;
+            odd_ = !odd_;
+        }
+    }
+}
+
+// vblank 期间只有进入 vblank 的那一点有工作；关闭渲染时可见行只输出背景色
+auto ppu::skip_idle(uint64_t time) -> bool {
+    const auto pre = timing_->prerender_line();
+    auto target = uint32_t{};
+    if (line_ >= 240 && line_ < pre) {
+        const auto vblank = clock_timing::vblank_line * clock_timing::dots + 1;
+        const auto here = line_ * clock_timing::dots + dot_;
+        target = (here <= vblank ? vblank : pre * clock_timing::dots) - here;
+    } else if (line_ < 240 && !rendering()) {
+        target = clock_timing::dots - dot_;
+    }
+    if (target == 0) {
+        return false;
+    }
+    const auto n = static_cast<uint32_t>(std::min<uint64_t>(target, (time - clock_) / timing_->ppu_div + 1));
+    if (line_ < 240) {
+        const auto first = std::max(dot_, 1u);
+        const auto last = std::min(dot_ + n, 257u);
+        if (first < last) {
+            const auto color = static_cast<uint8_t>(palette_ram_idx_[0] & (r_mask_.greyscale ? 0x30 : 0x3f));
+            std::fill_n(frame_.data() + line_ * 256 + first - 1, last - first, color);
+        }
+    }
+    advance(n);
+    return true;
+}
+
+// 每 8 个点取一个图块的名称表、属性与两个图案字节，之后装入移位寄存器的低字节
+auto ppu::fetch_bg() -> void {
+    bg_lo_ <<= 1;
+    bg_hi_ <<= 1;
+    at_lo_ <<= 1;
+    at_hi_ <<= 1;
+    const auto table = r_ctrl_.bg_table_addr << 12;
+    const auto fine_y = (v_ >> 12) & 0x7;
+    switch ((dot_ - 1) & 0x7) {
+        case 0:
+            load_bg();
+            next_nt_ = nametable(0x2000 | (v_ & 0x0fff));
+            break;
+        case 2:
+            next_at_ = attribute();
+            break;
+        case 4:
+            next_lo_ = ppu_bus_read(table + next_nt_ * 16 + fine_y);
             break;
         case 6:
-            r_vram_addr_ = data;
+            next_hi_ = ppu_bus_read(table + next_nt_ * 16 + fine_y + 8);
             break;
         case 7:
-            // todo))
+            inc_x();
+            break;
+    }
+}
+
+auto ppu::fetch_tile() -> void {
+    const auto table = r_ctrl_.bg_table_addr << 12;
+    const auto fine_y = (v_ >> 12) & 0x7;
+    next_nt_ = nametable(0x2000 | (v_ & 0x0fff));
+    next_at_ = attribute();
+    next_lo_ = ppu_bus_read(table + next_nt_ * 16 + fine_y);
+    next_hi_ = ppu_bus_read(table + next_nt_ * 16 + fine_y + 8);
+}
+
+// v 所在的 2x2 图块区域在属性表中的两位
+auto ppu::attribute() -> uint8_t {
+    const auto at = nametable(0x23c0 | (v_ & 0x0c00) | ((v_ >> 4) & 0x38) | ((v_ >> 2) & 0x07));
+    return (at >> (((v_ >> 4) & 0x4) | (v_ & 0x2))) & 0x3;
+}
+
+auto ppu::load_bg() -> void {
+    bg_lo_ = (bg_lo_ & 0xff00) | next_lo_;
+    bg_hi_ = (bg_hi_ & 0xff00) | next_hi_;
+    at_lo_ = (at_lo_ & 0xff00) | (next_at_ & 0x1 ? 0xff : 0x00);
+    at_hi_ = (at_hi_ & 0xff00) | (next_at_ & 0x2 ? 0xff : 0x00);
+}
+
+// 没有模拟硬件中溢出标志的错误判断
+auto ppu::evaluate_sprites() -> void {
+    const auto height = r_ctrl_.sprite_size ? 16u : 8u;
+    sprite_count_ = 0;
+    sprite0_line_ = false;
+    for (auto i = 0; i < 64; ++i) {
+        const auto &sp = oam_[i];
+        const auto row = line_ - sp.y_pos;
+        if (row >= height) {
+            continue;
+        }
+        if (sprite_count_ == 8) {
+            r_stat_.sp_overflow = 1;
+            break;
+        }
+        sprite0_line_ |= i == 0;
+        sprites_[sprite_count_++] = sprite_row(sp, row);
     }
-}
\ No newline at end of file
+}
+
+// row 为 sprite 内的行，垂直翻转在这里处理，水平翻转使用 chr 缓存中翻转过的一份
+auto ppu::sprite_row(const oam_entry &sp, uint32_t row) -> line_sprite {
+    const auto height = r_ctrl_.sprite_size ? 16u : 8u;
+    const auto y = sp.attr & 0x80 ? height - 1 - row : row;
+    auto addr = uint16_t{};
+    if (height == 16) {
+        addr = ((sp.tile_idx & 0x1) << 12) | ((sp.tile_idx & 0xfe) + (y >> 3)) * 16 | (y & 0x7);
+    } else {
+        addr = (r_ctrl_.sprite_table_addr << 12) | sp.tile_idx * 16 | y;
+    }
+    auto s = line_sprite{.pixels = {}, .attr = sp.attr, .x_pos = sp.x_pos};
+    if (cart_) {
+        std::memcpy(s.pixels, cart_->chr_row(addr, sp.attr & 0x40), 8);
+    }
+    return s;
+}
+
+// sprite 按 oam 顺序决定优先级，第一个不透明的像素与背景比较
+auto ppu::render_pixel(uint32_t x) -> void {
+    auto bg = 0;
+    auto bg_pal = 0;
+    if (r_mask_.showbg && (x >= 8 || r_mask_.showbg_l)) {
+        const auto bit = 0x8000 >> fine_x_;
+        bg = ((bg_lo_ & bit) ? 1 : 0) | ((bg_hi_ & bit) ? 2 : 0);
+        bg_pal = ((at_lo_ & bit) ? 1 : 0) | ((at_hi_ & bit) ? 2 : 0);
+    }
+    auto sp = 0;
+    auto sp_pal = 0;
+    auto sp_front = false;
+    if (r_mask_.showsp && (x >= 8 || r_mask_.showsp_l)) {
+        for (auto i = 0; i < sprite_count_; ++i) {
+            const auto &s = sprites_[i];
+            const auto off = x - s.x_pos;
+            if (off > 7) {
+                continue;
+            }
+            sp = s.pixels[off];
+            if (sp == 0) {
+                continue;
+            }
+            sp_pal = 4 + (s.attr & 0x3);
+            sp_front = !(s.attr & 0x20);
+            if (i == 0 && sprite0_line_ && bg && x != 255) {
+                r_stat_.sp_zero_hint = 1;
+            }
+            break;
+        }
+    }
+    auto idx = 0;
+    if (sp && (sp_front || !bg)) {
+        idx = sp_pal * 4 + sp;
+    } else if (bg) {
+        idx = bg_pal * 4 + bg;
+    }
+    frame_[line_ * 256 + x] = palette_ram_idx_[idx] & (r_mask_.greyscale ? 0x30 : 0x3f);
+}
+
+// 整行绘制：可见行在第 1 点一次画完 256 个像素，同时完成第 2 ~ 256 点的取图块与 v 的递增，
+// 之后从第 257 点照常执行 sprite 求值与 a12 信号。预渲染行的第 2 ~ 256 点与各行第 261 ~ 320 点
+// 取到的数据会被之后的复制与预取覆盖，直接跳过
+auto ppu::draw_line() -> bool {
+    if (!rendering() || (line_ >= 240 && line_ != timing_->prerender_line())) {
+        return false;
+    }
+    if (dot_ == 261) {
+        if (line_ == timing_->prerender_line()) {
+            copy_y();
+        }
+        advance(321 - 261);
+        return true;
+    }
+    if (line_ == timing_->prerender_line()) {
+        if (dot_ != 2) {
+            return false;
+        }
+        advance(257 - 2);
+        return true;
+    }
+    if (dot_ != 1) {
+        return false;
+    }
+
+    // 背景的图块流：移位寄存器中预取的两个图块，加上本行取的 31 个。
+    // 本行的图块从解码缓存中整行复制，属性每个图块一项
+    auto bg = std::array<uint8_t, 33 * 8>{};
+    auto attr = std::array<uint8_t, 33>{};
+    for (auto px = 0u; px < 8; ++px) {
+        const auto bit = 15 - px;
+        bg[px] = ((bg_lo_ >> bit) & 1) | (((bg_hi_ >> bit) & 1) << 1);
+        bg[8 + px] = ((bg_lo_ >> (bit - 8)) & 1) | (((bg_hi_ >> (bit - 8)) & 1) << 1);
+    }
+    attr[0] = ((at_lo_ >> 15) & 1) | ((at_hi_ >> 14) & 2);
+    attr[1] = ((at_lo_ >> 7) & 1) | ((at_hi_ >> 6) & 2);
+    const auto table = r_ctrl_.bg_table_addr << 12;
+    const auto fine_y = (v_ >> 12) & 0x7;
+    for (auto k = 2u; k < 33; ++k) {
+        const auto tile = nametable(0x2000 | (v_ & 0x0fff));
+        attr[k] = attribute();
+        if (cart_) {
+            std::memcpy(bg.data() + k * 8, cart_->chr_row(table + tile * 16 + fine_y), 8);
+        }
+        inc_x();
+    }
+    fetch_tile(); // 第 33 个图块在第 257 点装入，不在本行显示
+    inc_x();
+    inc_y();
+    bg_lo_ = bg_hi_ = at_lo_ = at_hi_ = 0;
+
+    // sprite 按 oam 顺序从后往前写入，前面的覆盖后面的。
+    // 低 2 位为图案，2 ~ 3 位为调色板，第 4 位在背景前，第 5 位为 sprite 0
+    auto sp = std::array<uint8_t, 256>{};
+    for (auto i = sprite_count_; i-- > 0;) {
+        const auto &s = sprites_[i];
+        const auto flags = static_cast<uint8_t>(((s.attr & 0x3) << 2) | (s.attr & 0x20 ? 0 : 0x10) | (i == 0 && sprite0_line_ ? 0x20 : 0));
+        for (auto px = 0u; px < 8 && s.x_pos + px < 256; ++px) {
+            const auto pattern = s.pixels[px];
+            if (pattern) {
+                sp[s.x_pos + px] = static_cast<uint8_t>(pattern | flags);
+            }
+        }
+    }
+
+    auto row = std::array<uint8_t, 256>{};
+    compose_bg_row(bg.data(), attr.data(), fine_x_, r_mask_, row.data());
+
+    const auto mask = static_cast<uint8_t>(r_mask_.greyscale ? 0x30 : 0x3f);
+    const auto sp_from = r_mask_.showsp ? (r_mask_.showsp_l ? 0u : 8u) : 256u;
+    auto *out = frame_.data() + line_ * 256;
+    for (auto x = 0u; x < 256; ++x) {
+        const auto b = row[x];
+        const auto s = x >= sp_from ? sp[x] : 0;
+        auto idx = 0;
+        if ((s & 0x3) && ((s & 0x10) || !(b & 0x3))) {
+            idx = 16 + (s & 0xf);
+        } else if (b & 0x3) {
+            idx = b;
+        }
+        if ((s & 0x20) && (b & 0x3) && x != 255) {
+            r_stat_.sp_zero_hint = 1;
+        }
+        out[x] = palette_ram_idx_[idx] & mask;
+    }
+    advance(257 - 1);
+    return true;
+}
+
+// 粗略 x 到 31 时切换到水平相邻的名称表
+auto ppu::inc_x() -> void {
+    if ((v_ & 0x001f) == 31) {
+        v_ = (v_ & ~0x001f) ^ 0x0400;
+    } else {
+        ++v_;
+    }
+}
+
+auto ppu::inc_y() -> void {
+    v_ = next_line(v_);
+}
+
+auto ppu::set_a12(bool high) -> void {
+    if (high && !a12_ && cart_) {
+        cart_->scanline();
+    }
+    a12_ = high;
+}
+
+// 从当前位置数到下一次 (line, dot) 的点数，跨过预渲染行末尾时考虑奇数帧少的一个点
+auto ppu::time_at(uint32_t line, uint32_t dot) -> uint64_t {
+    const auto pre = timing_->prerender_line();
+    const auto here = line_ * clock_timing::dots + dot_;
+    const auto target = line * clock_timing::dots + dot;
+    auto dots = uint64_t{target} - here;
+    if (target < here) {
+        const auto decided = here > pre * clock_timing::dots + 1; // 预渲染行第 1 点已经执行
+        const auto skip = decided ? short_frame_ : timing_->odd_frame_skip && odd_ && rendering();
+        dots = uint64_t{timing_->scanlines} * clock_timing::dots - here + target - (skip ? 1 : 0);
+    }
+    return clock_ + dots * timing_->ppu_div;
+}
+
+auto ppu::sprite0_time() -> uint64_t {
+    if (!predicted_ || clock_ > status_change_) {
+        predict();
+    }
+    return sprite0_time_;
+}
+
+// 根据当前的滚动、名称表、图案与 oam 预测下一次状态位变化：vblank 的设置与清除时刻固定，
+// sprite 0 命中与 sprite 溢出按当前状态逐行计算。期间寄存器、oam、chr 改变时预测失效
+auto ppu::predict() -> void {
+    predicted_ = true;
+    sprite0_time_ = predict_sprite0();
+    status_change_ = std::min({time_at(clock_timing::vblank_line, 1), time_at(timing_->prerender_line(), 1),
+                               sprite0_time_, predict_overflow()});
+}
+
+// 接下来渲染的可见行中第一个 first 行及其开始时 v 的垂直与水平部分
+auto ppu::next_visible_line(uint32_t &first, uint16_t &vert, uint16_t &horiz) -> void {
+    const auto pre = timing_->prerender_line();
+    if (line_ < 240) {
+        first = line_ + 1;
+        vert = (dot_ <= 256 ? next_line(v_) : v_) & 0x7be0;
+        horiz = dot_ > 257 ? line_h_ : t_ & 0x041f;
+    } else {
+        first = 0;
+        vert = (line_ == pre && dot_ > 304 ? v_ : t_) & 0x7be0;
+        horiz = line_ == pre && dot_ > 257 ? line_h_ : t_ & 0x041f;
+    }
+}
+
+// 当前正在渲染的行无法确定剩余像素的背景，保守地取 sprite 0 下一个不透明像素的时刻
+auto ppu::predict_sprite0() -> uint64_t {
+    if (!r_mask_.showbg || !r_mask_.showsp) {
+        return scheduler::never;
+    }
+    const auto &sp = oam_[0];
+    const auto height = r_ctrl_.sprite_size ? 16u : 8u;
+    const auto clip = !r_mask_.showbg_l || !r_mask_.showsp_l;
+    if (line_ < 240) {
+        if (r_stat_.sp_zero_hint) {
+            return scheduler::never; // 本帧已经命中，预渲染行之前不会再变化
+        }
+        if (sprite0_line_ && dot_ <= 256) {
+            const auto &s = sprites_[0];
+            for (auto px = 0u; px < 8; ++px) {
+                const auto x = sp.x_pos + px;
+                if (x + 1 >= dot_ && x < 255 && !(clip && x < 8) && s.pixels[px]) {
+                    return time_at(line_, x + 1);
+                }
+            }
+        }
+    }
+    auto first = uint32_t{};
+    auto vert = uint16_t{};
+    auto horiz = uint16_t{};
+    next_visible_line(first, vert, horiz);
+    for (auto line = first; line < 240; ++line) {
+        const auto row = line - 1 - sp.y_pos;
+        if (row < height) {
+            const auto s = sprite_row(sp, row);
+            for (auto px = 0u; px < 8; ++px) {
+                const auto x = sp.x_pos + px;
+                if (x < 255 && !(clip && x < 8) && s.pixels[px] && bg_opaque(vert, horiz, x)) {
+                    return time_at(line, x + 1);
+                }
+            }
+        }
+        vert = next_line(vert) & 0x7be0;
+        horiz = t_ & 0x041f;
+    }
+    return scheduler::never;
+}
+
+// sprite 溢出在每行的 dot 257 求值，用差分数组统计每行的 sprite 数
+auto ppu::predict_overflow() -> uint64_t {
+    if (!rendering() || r_stat_.sp_overflow) {
+        return scheduler::never;
+    }
+    const auto height = r_ctrl_.sprite_size ? 16u : 8u;
+    auto delta = std::array<int8_t, 256 + 16>{};
+    for (const auto &sp : oam_) {
+        ++delta[sp.y_pos];
+        --delta[sp.y_pos + height];
+    }
+    const auto first = line_ < 240 ? line_ + (dot_ > 257 ? 1 : 0) : 0;
+    auto count = 0;
+    for (auto line = 0u; line < 240; ++line) {
+        count += delta[line];
+        if (line >= first && count > 8) {
+            return time_at(line, 257);
+        }
+    }
+    return scheduler::never;
+}
+
+// 背景在第 x 列是否不透明，vert 与 horiz 为该行开始时 v 的垂直与水平部分
+auto ppu::bg_opaque(uint16_t vert, uint16_t horiz, uint32_t x) -> bool {
+    const auto pos = (horiz & 0x1f) * 8 + fine_x_ + x;
+    const auto nt_x = ((horiz >> 10) & 1) ^ ((pos >> 8) & 1);
+    const auto tile = nametable(0x2000 | (nt_x << 10) | (vert & 0x0be0) | ((pos >> 3) & 0x1f));
+    const auto addr = (r_ctrl_.bg_table_addr << 12) + tile * 16 + ((vert >> 12) & 0x7);
+    return cart_ && cart_->chr_row(addr)[pos & 0x7];
+}
@@ -1,9 +1,9 @@
 #pragma once
 #include "cartridge.h"
+#include "scheduler.h"
+#include <array>
 #include <cstdint>
 
-class bus;
-
 // ctrl 寄存器
 struct ppu_reg_ctrl {
     uint8_t name_table_idx : 2;
@@ -46,34 +46,127 @@ struct oam_entry {
     uint8_t x_pos;
 };
 
+// 下一条扫描线上的 sprite，图案已按水平翻转调整，从左到右 8 个 0 ~ 3 的像素
+struct line_sprite {
+    uint8_t pixels[8];
+    uint8_t attr;
+    uint8_t x_pos;
+};
+
+// ppu 的绘制方式，每个游戏可以单独选择
+enum class ppu_render : uint8_t {
+    dot,      // 逐点绘制，行中间的寄存器写入立即生效，默认
+    scanline, // 每行一次画完，寄存器写入在行边界生效，用于批量运行
+};
+
+// 按点执行的 ppu，不与 cpu 同步推进：只在 cpu 访问寄存器、mapper 需要 a12 信号、
+// 帧结束等时刻由 bus 调用 run_to 追赶到当前的主时钟，中间的点一次执行完
 class ppu {
   public:
-    ppu(bus &b) : bus_(b) {}
+    auto connect(cartridge *cart, uint8_t *vram) -> void;                        // chr 与名称表镜像来自卡带，vram 为 2KB 名称表
+    auto reset_timing(const clock_timing &timing, uint64_t frame_start) -> void; // 从 frame_start 开始新的一帧
+    auto run_to(uint64_t time) -> void;                                          // 执行开始时刻不晚于 time 的所有点
+    auto set_render(ppu_render render) -> void { render_ = render; }
 
-  public:
-    auto cpu_bus_read(uint16_t addr) -> uint8_t;
-    auto cpu_bus_write(uint16_t addr, uint8_t data) -> void;
+    // 先追赶到 time 再访问寄存器
+    auto cpu_bus_read(uint16_t addr, uint64_t time) -> uint8_t;
+    auto cpu_bus_write(uint16_t addr, uint8_t data, uint64_t time) -> void;
 
     auto ppu_bus_read(uint16_t addr) -> uint8_t;
-    auto ppu_bus_write(uint16_t addr) -> void;
+    auto ppu_bus_write(uint16_t addr, uint8_t data) -> void;
+
+    auto oam_dma(const uint8_t *page) -> void; // 从 oam_addr_ 开始写入 256 字节
+    auto nmi_enabled() -> bool { return r_ctrl_.nmi; }
+    auto in_vblank() -> bool { return r_stat_.v_blank; }
+    auto rendering() -> bool { return r_mask_.showbg || r_mask_.showsp; }
+    // a12 上升沿所在的点：背景用 $1000 且 sprite 用 $0000 时在取下一行背景时，否则在取 sprite 时
+    auto a12_dot() -> uint32_t { return !r_ctrl_.sprite_size && !r_ctrl_.sprite_table_addr && r_ctrl_.bg_table_addr ? 324 : 260; }
+    auto frame_buffer() -> const uint8_t * { return frame_.data(); } // 256x240 的调色板颜色
+    auto scanline() -> uint32_t { return line_; }
+    auto dot() -> uint32_t { return dot_; }
+
+    // 状态位变化时刻的预测，寄存器、oam 或 chr 改变后失效，下次使用时重新计算
+    auto time_at(uint32_t line, uint32_t dot) -> uint64_t; // 下一次到达 line 行 dot 点的主时钟
+    auto sprite0_time() -> uint64_t;                       // 下一次 sprite 0 命中的时刻，不会命中时为 never
+    auto invalidate() -> void { predicted_ = false; }      // chr bank、镜像方式等卡带状态改变
+
+  private:
+    auto tick() -> void;                   // 执行当前点
+    auto advance(uint32_t n) -> void;      // 前进 n 个点
+    auto skip_idle(uint64_t time) -> bool; // 跳过没有工作的点，返回是否跳过
+    auto draw_line() -> bool;              // 整行绘制模式下一次执行一段点，返回是否执行
+    auto fetch_tile() -> void;             // 一次取完当前图块的四个字节
+    auto fetch_bg() -> void;
+    auto load_bg() -> void;
+    auto attribute() -> uint8_t;
+    auto evaluate_sprites() -> void;       // 在 dot 257 为下一条扫描线选出最多 8 个 sprite
+    auto sprite_row(const oam_entry &sp, uint32_t row) -> line_sprite;
+    auto render_pixel(uint32_t x) -> void;
+    auto inc_x() -> void;
+    auto inc_y() -> void;
+    auto copy_x() -> void { v_ = (v_ & ~0x041f) | (t_ & 0x041f); }
+    auto copy_y() -> void { v_ = (v_ & ~0x7be0) | (t_ & 0x7be0); }
+    auto set_a12(bool high) -> void;       // a12 上升沿驱动 mmc3 的扫描线计数
+    auto nametable(uint16_t addr) -> uint8_t &;
+    auto palette(uint16_t addr) -> uint8_t &;
+
+    // 预测
+  private:
+    auto predict() -> void;
+    auto predict_sprite0() -> uint64_t;
+    auto predict_overflow() -> uint64_t;
+    auto next_visible_line(uint32_t &first, uint16_t &vert, uint16_t &horiz) -> void;
+    auto bg_opaque(uint16_t vert, uint16_t horiz, uint32_t x) -> bool;
 
     // 寄存器
   private:
     ppu_reg_ctrl r_ctrl_{};
     ppu_reg_mask r_mask_{};
     ppu_reg_status r_stat_{};
-    uint8_t r_oam_addr_{};
-    uint8_t r_oam_data_{};
-    uint8_t r_scroll_{};
-    uint8_t r_vram_addr_{};
-    uint8_t r_vram_data_{};
+    uint16_t v_{};          // 当前 vram 地址
+    uint16_t t_{};          // 临时 vram 地址，即左上角的滚动位置
+    uint8_t fine_x_{};      // 水平精细滚动
+    bool w_{};              // $2005、$2006 的第二次写入
+    uint8_t read_buffer_{}; // $2007 读取缓冲
 
     // 内部存储
   private:
     uint8_t palette_ram_idx_[32]{};
     uint8_t oam_addr_{};
     oam_entry oam_[64]{};
+    cartridge *cart_{};
+    uint8_t *vram_{};
+    std::array<uint8_t, 256 * 240> frame_{};
+
+    // 时序
+  private:
+    const clock_timing *timing_{&ntsc_timing};
+    ppu_render render_{ppu_render::dot};
+    uint64_t clock_{};  // 下一个点开始的主时钟
+    uint32_t line_{};   // 当前扫描线，0 ~ 239 为可见行
+    uint32_t dot_{};    // 当前点，0 ~ 340
+    bool odd_{};        // 奇数帧
+    bool short_frame_{};
+    bool a12_{};        // 上一次访问图案表时的地址线 a12
+    uint16_t line_h_{}; // 本行 dot 257 复制后 v 的水平部分
+
+    // 背景与 sprite 流水线
+  private:
+    uint8_t next_nt_{};
+    uint8_t next_at_{};
+    uint8_t next_lo_{};
+    uint8_t next_hi_{};
+    uint16_t bg_lo_{};    // 图案移位寄存器，高字节为当前图块
+    uint16_t bg_hi_{};
+    uint16_t at_lo_{};    // 属性移位寄存器
+    uint16_t at_hi_{};
+    std::array<line_sprite, 8> sprites_{};
+    uint8_t sprite_count_{};
+    bool sprite0_line_{}; // sprites_[0] 是 oam 中的 sprite 0
 
+    // 预测结果
   private:
-    bus &bus_;
+    bool predicted_{};
+    uint64_t status_change_{}; // 状态位下一次可能变化的时刻，在此之前读取 $2002 不需要追赶
+    uint64_t sprite0_time_{};
 };
\ No newline at end of file
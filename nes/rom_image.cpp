@@ -0,0 +1,270 @@
+#include "rom_image.h"
+#include "archive.h"
+#include "hash.h"
+#include "header_fixups.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+// 按 8 字节处理的 fnv-1a，只用于去重，相等时仍会比较内容
+auto content_hash(std::span<const uint8_t> data) -> uint64_t {
+    constexpr auto prime = 0x100000001b3ull;
+    auto h = 0xcbf29ce484222325ull ^ data.size();
+    auto i = size_t{};
+    for (; i + 8 <= data.size(); i += 8) {
+        auto w = uint64_t{};
+        std::memcpy(&w, data.data() + i, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 29;
+    }
+    for (; i < data.size(); ++i) {
+        h = (h ^ data[i]) * prime;
+    }
+    return h;
+}
+
+// 已加载的映像，只保存弱引用，不延长映像的生命周期
+struct rom_store {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<const rom_image>> images;
+};
+
+auto store() -> rom_store & {
+    static auto s = rom_store{};
+    return s;
+}
+
+// 解压得到的映像按压缩文件的内容缓存，批量任务反复加载同一个压缩文件时不必重新解压。
+// 缓存持有强引用，总大小超过 budget 时淘汰最久未使用的
+struct archive_cache {
+    static constexpr auto budget = size_t{64} << 20;
+
+    struct entry {
+        uint64_t hash;
+        uint32_t crc;
+        std::shared_ptr<const rom_image> rom;
+        uint64_t used;
+    };
+
+    std::mutex mutex;
+    std::vector<entry> entries;
+    size_t bytes{};
+    uint64_t clock{};
+
+    auto find(uint64_t hash, uint32_t crc) -> std::shared_ptr<const rom_image> {
+        const auto lock = std::lock_guard{mutex};
+        for (auto &e : entries) {
+            if (e.hash == hash && e.crc == crc) {
+                e.used = ++clock;
+                return e.rom;
+            }
+        }
+        return nullptr;
+    }
+
+    auto insert(uint64_t hash, uint32_t crc, std::shared_ptr<const rom_image> rom) -> void {
+        const auto lock = std::lock_guard{mutex};
+        bytes += rom->size();
+        entries.push_back({hash, crc, std::move(rom), ++clock});
+        while (bytes > budget && entries.size() > 1) {
+            const auto it = std::ranges::min_element(entries, {}, &entry::used);
+            bytes -= it->rom->size();
+            entries.erase(it);
+        }
+    }
+};
+
+auto archives() -> archive_cache & {
+    static auto c = archive_cache{};
+    return c;
+}
+
+} // namespace
+
+rom_image::rom_image(mapped_file file) : file_(std::move(file)), data_(file_.data()) {}
+
+rom_image::rom_image(std::vector<uint8_t> unpacked) : unpacked_(std::move(unpacked)), data_(unpacked_) {}
+
+auto rom_image::load(const std::string &filename) -> std::shared_ptr<const rom_image> {
+    auto file = mapped_file{filename};
+    if (!file.valid()) {
+        return nullptr;
+    }
+    if (!is_archive(file.data())) {
+        return share(map(std::move(file)));
+    }
+
+    const auto hash = content_hash(file.data());
+    const auto crc = crc32(file.data());
+    if (auto cached = archives().find(hash, crc)) {
+        return cached;
+    }
+    auto rom = share(map(std::move(file)));
+    if (rom) {
+        archives().insert(hash, crc, rom);
+    }
+    return rom;
+}
+
+auto rom_image::share(std::shared_ptr<rom_image> rom) -> std::shared_ptr<const rom_image> {
+    if (!rom) {
+        return nullptr;
+    }
+    rom->hash_ = content_hash(rom->content());
+
+    auto &s = store();
+    const auto lock = std::lock_guard{s.mutex};
+    auto &slot = s.images[rom->hash_];
+    if (auto cached = slot.lock()) {
+        const auto a = cached->content(), b = rom->content();
+        if (std::ranges::equal(a, b)) {
+            return cached; // 新的映射随 rom 一起释放
+        }
+        return rom; // 哈希冲突，不共享
+    }
+    slot = rom;
+    std::erase_if(s.images, [](const auto &kv) { return kv.second.expired(); });
+    return rom;
+}
+
+auto rom_image::open(const std::string &filename) -> std::shared_ptr<const rom_image> {
+    auto file = mapped_file{filename};
+    if (!file.valid()) {
+        return nullptr;
+    }
+    return map(std::move(file));
+}
+
+auto rom_image::map(mapped_file file) -> std::shared_ptr<rom_image> {
+    auto rom = std::shared_ptr<rom_image>{};
+    if (is_archive(file.data())) {
+        auto unpacked = extract_archive(file.data());
+        if (!unpacked) {
+            return nullptr;
+        }
+        rom.reset(new rom_image(std::move(*unpacked))); // 压缩文件的映射在此之后释放
+    } else {
+        rom.reset(new rom_image(std::move(file)));
+    }
+    if (!rom->parse()) {
+        return nullptr;
+    }
+    return rom;
+}
+
+auto rom_image::parse() -> bool {
+    if (data_.size() < sizeof(header_)) {
+        return false;
+    }
+    std::memcpy(&header_, data_.data(), sizeof(header_));
+    offset_ = sizeof(header_);
+    if (std::string_view(header_.identify, 4) != "NES\x1A" || !parse_header()) {
+        return false;
+    }
+
+    if (header_.flag_6 & 0x04) {
+        trainer_ = take(512);
+        if (trainer_.empty()) {
+            return false;
+        }
+    }
+    prg_rom_ = take(info_.prg_rom_size);
+    if (prg_rom_.empty()) {
+        return false;
+    }
+    if (info_.chr_rom_size != 0) {
+        chr_rom_ = take(info_.chr_rom_size);
+        if (chr_rom_.empty()) {
+            return false;
+        }
+    }
+    // 与修正数据库相同，只计算 prg 与 chr，不含文件尾部的多余数据
+    crc_ = crc32(chr_rom_, crc32(prg_rom_));
+    apply_fixup();
+    return true;
+}
+
+// https://www.nesdev.org/wiki/NES_2.0
+auto rom_image::parse_header() -> bool {
+    const auto &h = header_;
+    auto &i = info_;
+    const auto version = (h.flag_7 >> 2) & 0b11;
+    if (version == 1 || version == 3) {
+        return false;
+    }
+    i.nes2 = version == 2;
+    if (h.flag_6 & 0x08) {
+        i.mirror = mirroring::four_screen;
+    } else {
+        i.mirror = h.flag_6 & 0x01 ? mirroring::vertical : mirroring::horizontal;
+    }
+    i.battery = h.flag_6 & 0x02;
+
+    if (!i.nes2) {
+        // 旧的转储工具会在 7 ~ 15 字节写入签名，此时 flag_7 的 mapper 高 4 位也不可信
+        const auto dirty = h.flag_12 | h.unused[0] | h.unused[1] | h.unused[2];
+        i.mapper = (h.flag_6 >> 4) | (dirty ? 0 : h.flag_7 & 0xf0);
+        i.timing = !dirty && (h.flag_9 & 0x01) ? tv_system::pal : tv_system::ntsc;
+        i.prg_rom_size = h.prg_rom_size * size_t{0x4000};
+        i.chr_rom_size = h.chr_rom_size * size_t{0x2000};
+        const auto ram = (dirty || h.flag_8 == 0 ? 1 : h.flag_8) * size_t{0x2000}; // 0 表示 8KB
+        (i.battery ? i.prg_nvram_size : i.prg_ram_size) = ram;
+        i.chr_ram_size = i.chr_rom_size == 0 ? 0x2000 : 0;
+        return true;
+    }
+
+    i.mapper = (h.flag_6 >> 4) | (h.flag_7 & 0xf0) | ((h.flag_8 & 0x0f) << 8);
+    i.submapper = h.flag_8 >> 4;
+    i.timing = static_cast<tv_system>(h.flag_12 & 0b11);
+
+    // 高 4 位为 0xf 时使用指数表示：2^E * (M * 2 + 1)
+    const auto rom_size = [](uint8_t lo, uint8_t hi, size_t unit) -> size_t {
+        if (hi == 0x0f) {
+            const auto e = lo >> 2;
+            return e < 62 ? (size_t{1} << e) * ((lo & 0b11) * 2 + 1) : 0;
+        }
+        return ((hi << 8) | lo) * unit;
+    };
+    // 移位数为 0 表示没有，否则为 64 << n 字节
+    const auto ram_size = [](int shift) -> size_t { return shift ? size_t{64} << shift : 0; };
+    i.prg_rom_size = rom_size(h.prg_rom_size, h.flag_9 & 0x0f, 0x4000);
+    i.chr_rom_size = rom_size(h.chr_rom_size, h.flag_9 >> 4, 0x2000);
+    i.prg_ram_size = ram_size(h.flag_10 & 0x0f);
+    i.prg_nvram_size = ram_size(h.flag_10 >> 4);
+    i.chr_ram_size = ram_size(h.flag_11 & 0x0f) + ram_size(h.flag_11 >> 4);
+    if (i.chr_rom_size == 0 && i.chr_ram_size == 0) { // 很多 nes2.0 转储省略了 chr ram 的大小
+        i.chr_ram_size = 0x2000;
+    }
+    return true;
+}
+
+auto rom_image::apply_fixup() -> void {
+    const auto f = find_header_fixup(crc_);
+    if (!f) {
+        return;
+    }
+    apply_header_fixup(info_, *f);
+}
+
+// 只读取信息的映像（open）与合并时被丢弃的映像不会解码
+auto rom_image::chr_tiles() const -> const chr_cache & {
+    std::call_once(chr_tiles_once_, [this] { chr_tiles_.reset(chr_rom_); });
+    return chr_tiles_;
+}
+
+auto rom_image::take(size_t size) -> std::span<const uint8_t> {
+    if (size == 0 || data_.size() - offset_ < size) {
+        return {};
+    }
+    const auto s = data_.subspan(offset_, size);
+    offset_ += size;
+    return s;
+}
+
+auto rom_image::content() const -> std::span<const uint8_t> {
+    return data_.first(offset_);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "chr_cache.h"
+#include "mapped_file.h"
+#include "mapper.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+// 卡带头部，ines 与 nes2.0 共用，flag_7 的第 2、3 位为 0b10 时为 nes2.0
+struct cart_header {
+    char identify[4];
+    uint8_t prg_rom_size; // 16KB 为单位，nes2.0 中为低 8 位
+    uint8_t chr_rom_size; // 8KB 为单位，nes2.0 中为低 8 位
+    uint8_t flag_6;
+    uint8_t flag_7;
+    uint8_t flag_8;  // ines：prg ram 大小；nes2.0：mapper 高 4 位与 submapper
+    uint8_t flag_9;  // ines：制式；nes2.0：prg、chr rom 大小的高 4 位
+    uint8_t flag_10; // nes2.0：prg ram 与 prg nvram 大小
+    uint8_t flag_11; // nes2.0：chr ram 与 chr nvram 大小
+    uint8_t flag_12; // nes2.0：制式
+    uint8_t unused[3];
+};
+static_assert(sizeof(cart_header) == 16);
+
+// 电视制式
+enum class tv_system : uint8_t {
+    ntsc,
+    pal,
+    multi, // 同时支持 ntsc 与 pal
+    dendy,
+};
+
+// 从头部解出的卡带参数，已经过修正数据库的更正
+struct rom_info {
+    bool nes2{};
+    int mapper{};
+    int submapper{};
+    mirroring mirror{};
+    bool battery{};
+    tv_system timing{};
+    size_t prg_rom_size{};
+    size_t chr_rom_size{};   // 为 0 时使用 chr ram
+    size_t prg_ram_size{};   // 易失的 prg ram
+    size_t prg_nvram_size{}; // 电池供电的 prg ram
+    size_t chr_ram_size{};   // 有 chr rom 时为 0
+    bool fixed{};            // 命中了修正数据库
+};
+
+// 卡带中只读的部分，加载后不再修改，可以被任意多个模拟器实例共享。
+// 内容相同的 rom 只保留一份映像，最后一个引用释放时解除映射
+class rom_image {
+  public:
+    // 文件可以是 .nes，或者压缩为 gzip、只含一个文件的 zip。文件不存在或格式无效时返回 nullptr
+    static auto load(const std::string &filename) -> std::shared_ptr<const rom_image>;
+    // 只映射并解析，不参与共享，用于只读取信息的场合
+    static auto open(const std::string &filename) -> std::shared_ptr<const rom_image>;
+
+    auto header() const -> const cart_header & { return header_; } // 文件中的原始头部
+    auto info() const -> const rom_info & { return info_; }
+    auto mapper_id() const -> int { return info_.mapper; }
+    auto trainer() const -> std::span<const uint8_t> { return trainer_; }
+    auto prg_rom() const -> std::span<const uint8_t> { return prg_rom_; }
+    auto chr_rom() const -> std::span<const uint8_t> { return chr_rom_; } // chr ram 的卡带为空
+    auto chr_tiles() const -> const chr_cache &;                          // 解码后的 chr rom，第一次调用时解码
+    auto crc() const -> uint32_t { return crc_; }                         // prg rom 与 chr rom 的 crc32
+    auto size() const -> size_t { return data_.size(); }                  // 映射或解压后的文件大小
+    auto hash() const -> uint64_t { return hash_; }                       // 头部与 rom 内容的哈希，open 得到的映像为 0
+
+  private:
+    explicit rom_image(mapped_file file);
+    explicit rom_image(std::vector<uint8_t> unpacked);
+
+    // 必要时先解压，然后解析
+    static auto map(mapped_file file) -> std::shared_ptr<rom_image>;
+    // 与已加载的内容相同的映像合并
+    static auto share(std::shared_ptr<rom_image> rom) -> std::shared_ptr<const rom_image>;
+    auto parse() -> bool;
+    auto parse_header() -> bool;                        // 由头部计算 info_ 中除修正以外的部分
+    auto apply_fixup() -> void;
+    auto take(size_t size) -> std::span<const uint8_t>; // 从文件中取出下一段数据，长度不足时返回空
+    auto content() const -> std::span<const uint8_t>;   // 头部到 chr rom 末尾，不含文件尾部的多余数据
+
+  private:
+    mapped_file file_;
+    std::vector<uint8_t> unpacked_; // 压缩文件解压后的内容
+    std::span<const uint8_t> data_; // file_ 或 unpacked_ 的全部数据
+    size_t offset_{};               // 下一段数据在 data_ 中的位置
+    cart_header header_{};
+    rom_info info_{};
+    std::span<const uint8_t> trainer_;
+    std::span<const uint8_t> prg_rom_;
+    std::span<const uint8_t> chr_rom_;
+    uint32_t crc_{};
+    uint64_t hash_{};
+    mutable std::once_flag chr_tiles_once_;
+    mutable chr_cache chr_tiles_; // 占用 chr rom 的 8 倍，只解码一次，所有实例共享
+};
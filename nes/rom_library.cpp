@@ -0,0 +1,196 @@
+#include "rom_library.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+// 索引文件格式，整数均为小端：
+//   "NESIDX" 版本(u16) 条目数(u32)
+//   每个条目：路径长度(u16) 路径 大小(u64) 修改时间(i64) 有效(u8) 头部(16) crc32(u32) sha-1(20)
+namespace {
+
+constexpr auto index_magic = std::string_view{"NESIDX"};
+constexpr auto index_version = uint16_t{1};
+
+class index_writer {
+  public:
+    explicit index_writer(std::ostream &os) : os_(os) {}
+
+    template <typename T>
+    auto put(T v) -> void {
+        for (auto i = 0u; i < sizeof(T); ++i) {
+            os_.put(static_cast<char>(static_cast<uint64_t>(v) >> (i * 8)));
+        }
+    }
+    auto put(const void *data, size_t n) -> void { os_.write(static_cast<const char *>(data), n); }
+
+  private:
+    std::ostream &os_;
+};
+
+class index_reader {
+  public:
+    explicit index_reader(std::istream &is) : is_(is) {}
+
+    template <typename T>
+    auto get() -> T {
+        auto v = uint64_t{};
+        for (auto i = 0u; i < sizeof(T); ++i) {
+            v |= static_cast<uint64_t>(static_cast<uint8_t>(is_.get())) << (i * 8);
+        }
+        return static_cast<T>(v);
+    }
+    auto get(void *data, size_t n) -> void { is_.read(static_cast<char *>(data), n); }
+    auto ok() -> bool { return static_cast<bool>(is_); }
+
+  private:
+    std::istream &is_;
+};
+
+// .nes 以及压缩后的 .nes.gz、.zip
+auto is_nes_file(const std::filesystem::path &p) -> bool {
+    auto name = p.filename().string();
+    std::ranges::transform(name, name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name.ends_with(".nes") || name.ends_with(".nes.gz") || name.ends_with(".zip");
+}
+
+} // namespace
+
+auto rom_library::scan(unsigned threads) -> rom_scan_stats {
+    namespace fs = std::filesystem;
+    auto stats = rom_scan_stats{};
+
+    auto known = std::unordered_map<std::string_view, const rom_entry *>{};
+    for (const auto &e : entries_) {
+        known.emplace(e.path, &e);
+    }
+
+    // 目录遍历只读取目录项，不打开文件
+    auto found = std::vector<rom_entry>{};
+    auto pending = std::vector<size_t>{}; // 需要重新计算的条目
+    auto ec = std::error_code{};
+    for (auto it = fs::recursive_directory_iterator{root_, fs::directory_options::skip_permission_denied, ec};
+         !ec && it != fs::recursive_directory_iterator{}; it.increment(ec)) {
+        if (!it->is_regular_file(ec) || !is_nes_file(it->path())) {
+            continue;
+        }
+        auto e = rom_entry{};
+        e.path = it->path().lexically_relative(root_).generic_string();
+        e.size = it->file_size(ec);
+        e.mtime = it->last_write_time(ec).time_since_epoch().count();
+        if (const auto k = known.find(e.path); k != known.end() && k->second->size == e.size && k->second->mtime == e.mtime) {
+            e = *k->second;
+            ++stats.reused;
+        } else {
+            pending.push_back(found.size());
+        }
+        found.push_back(std::move(e));
+    }
+    stats.files = found.size();
+    stats.hashed = pending.size();
+
+    // 各线程从同一个计数器领取文件，文件大小差别很大，逐个领取比预先均分更均衡
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, pending.size()));
+    auto next = std::atomic<size_t>{};
+    auto work = [&] {
+        for (auto i = next++; i < pending.size(); i = next++) {
+            auto &e = found[pending[i]];
+            index_entry(root_ / e.path, e);
+        }
+    };
+    {
+        auto pool = std::vector<std::jthread>{};
+        for (auto i = 1u; i < threads; ++i) {
+            pool.emplace_back(work);
+        }
+        work();
+    }
+
+    for (const auto i : pending) {
+        stats.invalid += !found[i].valid;
+    }
+    std::ranges::sort(found, {}, &rom_entry::path);
+    entries_ = std::move(found);
+    return stats;
+}
+
+auto rom_library::index_entry(const std::filesystem::path &file, rom_entry &e) -> void {
+    const auto rom = rom_image::open(file.string());
+    e.valid = rom != nullptr;
+    if (!rom) {
+        return;
+    }
+    e.header = rom->header();
+    e.crc = rom->crc();
+    auto h = sha1{};
+    h.update(rom->prg_rom());
+    h.update(rom->chr_rom());
+    e.sha = h.finish();
+}
+
+auto rom_library::load_index(const std::filesystem::path &file) -> bool {
+    auto ifs = std::ifstream{file, std::ios::binary};
+    auto r = index_reader{ifs};
+    auto magic = std::array<char, index_magic.size()>{};
+    r.get(magic.data(), magic.size());
+    if (!r.ok() || std::string_view{magic.data(), magic.size()} != index_magic || r.get<uint16_t>() != index_version) {
+        return false;
+    }
+
+    // 条目数来自文件，不按它预先分配，数据提前结束时读取失败返回
+    const auto count = r.get<uint32_t>();
+    auto entries = std::vector<rom_entry>{};
+    for (auto i = 0u; i < count; ++i) {
+        auto &e = entries.emplace_back();
+        e.path.resize(r.get<uint16_t>());
+        r.get(e.path.data(), e.path.size());
+        e.size = r.get<uint64_t>();
+        e.mtime = r.get<int64_t>();
+        e.valid = r.get<uint8_t>() != 0;
+        r.get(&e.header, sizeof(e.header));
+        e.crc = r.get<uint32_t>();
+        r.get(e.sha.data(), e.sha.size());
+        if (!r.ok()) {
+            return false;
+        }
+    }
+    entries_ = std::move(entries);
+    return true;
+}
+
+auto rom_library::save_index(const std::filesystem::path &file) const -> bool {
+    // 先写入临时文件再替换，中途失败不会破坏原有的索引
+    auto tmp = file;
+    tmp += ".tmp";
+    {
+        auto ofs = std::ofstream{tmp, std::ios::binary | std::ios::trunc};
+        auto w = index_writer{ofs};
+        w.put(index_magic.data(), index_magic.size());
+        w.put(index_version);
+        w.put(static_cast<uint32_t>(entries_.size()));
+        for (const auto &e : entries_) {
+            const auto len = static_cast<uint16_t>(std::min<size_t>(e.path.size(), 0xffff));
+            w.put(len);
+            w.put(e.path.data(), len);
+            w.put(e.size);
+            w.put(e.mtime);
+            w.put(static_cast<uint8_t>(e.valid));
+            w.put(&e.header, sizeof(e.header));
+            w.put(e.crc);
+            w.put(e.sha.data(), e.sha.size());
+        }
+        if (!ofs.flush()) {
+            return false;
+        }
+    }
+    auto ec = std::error_code{};
+    std::filesystem::rename(tmp, file, ec);
+    return !ec;
+}
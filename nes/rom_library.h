@@ -0,0 +1,48 @@
+#pragma once
+#include "hash.h"
+#include "rom_image.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// rom 库中一个文件的信息
+struct rom_entry {
+    std::string path;    // 相对于库根目录，使用 '/' 分隔
+    uint64_t size{};     // 文件大小
+    int64_t mtime{};     // 修改时间，只用于判断文件是否变化
+    bool valid{};        // 头部有效，以下字段才有意义
+    cart_header header{};
+    uint32_t crc{};      // prg rom + chr rom 的 crc32，不含头部与 trainer
+    sha1::digest sha{};  // prg rom + chr rom 的 sha-1
+};
+
+// 扫描结果统计
+struct rom_scan_stats {
+    size_t files{};   // 找到的 rom 文件
+    size_t reused{};  // 大小与修改时间未变，沿用索引中的结果
+    size_t hashed{};  // 重新读取并计算哈希
+    size_t invalid{}; // 重新读取的文件中无法打开或头部无效的
+};
+
+// 目录树下 rom 文件（.nes、.nes.gz、.zip）的索引。扫描时只重新读取新增或发生变化的文件，
+// 读取与哈希计算分给多个线程进行，结果可以保存为二进制索引文件
+class rom_library {
+  public:
+    explicit rom_library(std::filesystem::path root) : root_(std::move(root)) {}
+
+    // threads 为 0 时使用硬件线程数
+    auto scan(unsigned threads = 0) -> rom_scan_stats;
+    auto load_index(const std::filesystem::path &file) -> bool;
+    auto save_index(const std::filesystem::path &file) const -> bool;
+
+    auto root() const -> const std::filesystem::path & { return root_; }
+    auto entries() const -> const std::vector<rom_entry> & { return entries_; } // 按路径排序
+
+  private:
+    static auto index_entry(const std::filesystem::path &file, rom_entry &e) -> void;
+
+  private:
+    std::filesystem::path root_;
+    std::vector<rom_entry> entries_;
+};
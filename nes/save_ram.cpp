@@ -0,0 +1,165 @@
+#include "save_ram.h"
+#include <bit>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+auto bitmap_words(size_t size) -> size_t {
+    return (size + save_ram::page_size * 64 - 1) / (save_ram::page_size * 64);
+}
+
+} // namespace
+
+save_ram::save_ram(size_t size) : size_(size), memory_(size) {
+    data_ = memory_.data();
+}
+
+save_ram::save_ram(const std::string &filename, size_t size)
+    : size_(size), dirty_(std::make_unique<std::atomic<uint64_t>[]>(bitmap_words(size))), dirty_words_(bitmap_words(size)) {
+    if (size_ != 0 && map_file(filename)) {
+        persistent_ = true;
+        flusher_ = std::jthread{[this](std::stop_token stop) { flush_loop(stop); }};
+    } else {
+        memory_.resize(size_);
+        data_ = memory_.data();
+    }
+}
+
+save_ram::~save_ram() {
+    if (flusher_.joinable()) {
+        flusher_.request_stop();
+        flusher_.join();
+    }
+    flush();
+    unmap_file();
+}
+
+// 连续的脏页合并为一次同步
+auto save_ram::flush() -> void {
+    if (!persistent_) {
+        return;
+    }
+    auto first = size_t{}, count = size_t{};
+    for (auto w = size_t{}; w < dirty_words_; ++w) {
+        auto bits = dirty_[w].exchange(0, std::memory_order_acq_rel);
+        for (; bits; bits &= bits - 1) {
+            const auto page = w * 64 + std::countr_zero(bits);
+            if (count && page == first + count) {
+                ++count;
+                continue;
+            }
+            if (count) {
+                sync(first * page_size, count * page_size);
+            }
+            first = page, count = 1;
+        }
+    }
+    if (count) {
+        sync(first * page_size, count * page_size);
+    }
+}
+
+auto save_ram::flush_loop(std::stop_token stop) -> void {
+    auto lock = std::unique_lock{wait_mutex_};
+    while (!stop.stop_requested()) {
+        wake_.wait_for(lock, stop, flush_interval, [] { return false; });
+        flush();
+    }
+}
+
+#ifdef _WIN32
+// 不与其他句柄共享写入，文件已被映射时第二次打开失败
+auto save_ram::map_file(const std::string &filename) -> bool {
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        return false;
+    }
+    // 文件比 size_ 短时映射会把文件扩展到 size_，新增的部分为 0
+    const auto size = static_cast<uint64_t>(size_);
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                  static_cast<DWORD>(size), nullptr);
+    if (mapping_) {
+        data_ = static_cast<uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, size_));
+    }
+    if (!data_) {
+        unmap_file();
+    }
+    return data_ != nullptr;
+}
+
+auto save_ram::unmap_file() -> void {
+    if (persistent_ && data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    if (file_) {
+        CloseHandle(file_);
+    }
+    mapping_ = file_ = nullptr;
+}
+
+auto save_ram::sync(size_t offset, size_t size) -> void {
+    FlushViewOfFile(data_ + offset, size);
+    FlushFileBuffers(file_);
+}
+#else
+// 每次 open 得到独立的文件描述，同一进程内的第二次打开也会在 flock 上失败
+auto save_ram::map_file(const std::string &filename) -> bool {
+    const auto fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return false;
+    }
+    // 新建或比 size_ 短的文件先扩展，新增的部分为 0
+    struct stat st {};
+    auto ok = ::fstat(fd, &st) == 0 && (static_cast<size_t>(st.st_size) >= size_ || ::ftruncate(fd, size_) == 0);
+    if (ok) {
+        const auto p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ok = p != MAP_FAILED;
+        if (ok) {
+            data_ = static_cast<uint8_t *>(p);
+        }
+    }
+    if (ok) {
+        fd_ = fd;
+    } else {
+        ::close(fd);
+    }
+    return ok;
+}
+
+auto save_ram::unmap_file() -> void {
+    if (persistent_ && data_) {
+        ::munmap(data_, size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_); // 同时释放 flock
+        fd_ = -1;
+    }
+}
+
+// msync 要求起始地址按系统页对齐，映射本身从系统页开始
+auto save_ram::sync(size_t offset, size_t size) -> void {
+    static const auto os_page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const auto begin = offset / os_page * os_page;
+    ::msync(data_ + begin, offset + size - begin, MS_SYNC);
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 卡带的 prg ram。有电池的卡带可以映射到 .sav 文件，写入时按 256 字节一页记录脏页，
+// 由后台线程定时与析构时刷回文件，模拟线程不等待磁盘；不需要保存时只在内存中。
+// 同一个文件同时只能被一个实例映射（包括其他进程），之后的打开退回内存模式，避免两个实例互相覆盖存档
+class save_ram {
+  public:
+    static constexpr auto page_size = 0x100;                        // 脏页的大小，与 cpu 的页表相同
+    static constexpr auto flush_interval = std::chrono::seconds{1}; // 后台刷新的间隔
+
+    explicit save_ram(size_t size = 0); // 只在内存中
+    save_ram(const std::string &filename, size_t size); // 文件无法打开时退回内存模式
+    save_ram(const save_ram &) = delete;
+    auto operator=(const save_ram &) -> save_ram & = delete;
+    ~save_ram();
+
+    auto data() -> uint8_t * { return data_; }
+    auto size() const -> size_t { return size_; }
+    auto persistent() const -> bool { return persistent_; } // 映射到了文件，写入需要调用 mark_dirty
+
+    auto mark_dirty(size_t offset) -> void { // 只能在文件模式下调用
+        const auto page = offset / page_size;
+        dirty_[page / 64].fetch_or(uint64_t{1} << (page % 64), std::memory_order_relaxed);
+    }
+    auto flush() -> void; // 立即把脏页写回文件
+
+  private:
+    auto map_file(const std::string &filename) -> bool;
+    auto unmap_file() -> void;
+    auto sync(size_t offset, size_t size) -> void;
+    auto flush_loop(std::stop_token stop) -> void;
+
+  private:
+    uint8_t *data_{};
+    size_t size_{};
+    bool persistent_{};
+    std::vector<uint8_t> memory_;                    // 内存模式的存储
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty_; // 脏页位图，只在文件模式下分配
+    size_t dirty_words_{};
+    std::mutex wait_mutex_;
+    std::condition_variable_any wake_;               // 后台线程等待下一次刷新
+    std::jthread flusher_;                           // 后台刷新线程，必须最后析构
+#ifdef _WIN32
+    void *file_{};    // CreateFile 返回的句柄
+    void *mapping_{}; // CreateFileMapping 返回的句柄
+#else
+    int fd_{-1}; // 映射期间保持打开并持有排他的 flock
+#endif
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include "rom_image.h"
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// 主时钟频率下各部件的分频，主时钟周期为计时单位
+struct clock_timing {
+    uint32_t cpu_div;    // 每个 cpu 周期的主时钟数
+    uint32_t ppu_div;    // 每个 ppu 点的主时钟数
+    uint32_t scanlines;  // 每帧扫描线数，含 vblank 与预渲染行
+    uint32_t apu_frame;  // apu 帧计数器 4 步模式下两次中断之间的 cpu 周期数
+    bool odd_frame_skip; // 开启渲染时奇数帧少一个点
+
+    static constexpr auto dots = 341u;        // 每条扫描线的点数
+    static constexpr auto vblank_line = 241u; // vblank 开始的扫描线
+
+    auto prerender_line() const -> uint32_t { return scanlines - 1; }
+    auto frame_length() const -> uint64_t { return uint64_t{scanlines} * dots * ppu_div; }
+};
+
+constexpr auto ntsc_timing = clock_timing{12, 4, 262, 29830, true};
+constexpr auto pal_timing = clock_timing{16, 5, 312, 33254, false};
+constexpr auto dendy_timing = clock_timing{15, 5, 312, 29830, false};
+
+constexpr auto timing_of(tv_system tv) -> const clock_timing & {
+    switch (tv) {
+        case tv_system::pal:
+            return pal_timing;
+        case tv_system::dendy:
+            return dendy_timing;
+        default:
+            return ntsc_timing;
+    }
+}
+
+// 调度的事件，每种事件同时最多有一个待处理
+enum class event : uint8_t {
+    vblank,     // 241 行第 1 点，设置 vblank 标志并按需触发 nmi
+    vblank_end, // 预渲染行第 1 点，清除状态标志，开始下一帧的安排
+    nmi,        // vblank 期间打开 nmi 时在下一条指令后触发
+    sprite0,    // sprite 0 命中
+    scanline,   // mapper 的扫描线计数
+    apu_frame,  // apu 帧计数器中断
+    dmc,        // dmc 取样本，dmc 通道尚未实现，目前不会安排
+    count,
+};
+
+// 以主时钟为键的最小堆；重新安排或取消事件时旧的堆项不删除，
+// 弹出时与该事件当前的时刻比较，不一致的直接丢弃
+class scheduler {
+  public:
+    struct entry {
+        uint64_t time;
+        event e;
+        auto operator<=>(const entry &o) const -> std::strong_ordering { return time <=> o.time; }
+        auto operator==(const entry &o) const -> bool { return time == o.time; }
+    };
+
+    static constexpr auto never = std::numeric_limits<uint64_t>::max();
+
+    auto schedule(event e, uint64_t time) -> void {
+        time_[index(e)] = time;
+        heap_.push_back({time, e});
+        std::ranges::push_heap(heap_, std::greater{});
+    }
+    auto cancel(event e) -> void { time_[index(e)] = never; }
+    auto pending(event e) const -> bool { return time_[index(e)] != never; }
+    auto time_of(event e) const -> uint64_t { return time_[index(e)]; }
+    auto clear() -> void {
+        heap_.clear();
+        time_ = idle();
+    }
+
+    // 最早的待处理事件的时刻，没有事件时为 never
+    auto next_time() -> uint64_t {
+        drop_stale();
+        return heap_.empty() ? never : heap_.front().time;
+    }
+
+    // 弹出一个时刻不晚于 now 的事件
+    auto pop(uint64_t now) -> std::optional<entry> {
+        drop_stale();
+        if (heap_.empty() || heap_.front().time > now) {
+            return std::nullopt;
+        }
+        const auto top = heap_.front();
+        std::ranges::pop_heap(heap_, std::greater{});
+        heap_.pop_back();
+        time_[index(top.e)] = never;
+        return top;
+    }
+
+  private:
+    using event_times = std::array<uint64_t, static_cast<size_t>(event::count)>;
+
+    static auto index(event e) -> size_t { return static_cast<size_t>(e); }
+    static constexpr auto idle() -> event_times {
+        auto t = event_times{};
+        t.fill(never);
+        return t;
+    }
+
+    auto drop_stale() -> void {
+        while (!heap_.empty() && heap_.front().time != time_[index(heap_.front().e)]) {
+            std::ranges::pop_heap(heap_, std::greater{});
+            heap_.pop_back();
+        }
+    }
+
+    std::vector<entry> heap_;   // 可能含有已作废的项
+    event_times time_ = idle(); // 各事件当前的时刻
+};
@@ -0,0 +1,45 @@
+#include "../nes/bg_row.h"
+#include "check.h"
+#include <bit>
+#include <cstring>
+
+namespace {
+
+// 固定种子的线性同余序列，每次运行的输入相同
+auto next_random(uint32_t &state) -> uint8_t {
+    state = state * 1664525 + 1013904223;
+    return static_cast<uint8_t>(state >> 24);
+}
+
+// simd 实现与逐像素的参考实现逐字节相同：覆盖全部 fine_x 与 mask 的组合
+auto matches_scalar() -> void {
+    auto state = uint32_t{1};
+    for (auto round = 0; round < 16; ++round) {
+        uint8_t pattern[33 * 8];
+        uint8_t attr[33];
+        for (auto &p : pattern) {
+            p = next_random(state) & 0x3;
+        }
+        for (auto &a : attr) {
+            a = next_random(state) & 0x3;
+        }
+        for (auto fine_x = 0u; fine_x < 8; ++fine_x) {
+            for (auto bits = 0; bits < 256; ++bits) {
+                const auto mask = std::bit_cast<ppu_reg_mask>(static_cast<uint8_t>(bits));
+                uint8_t out[256];
+                uint8_t expect[256];
+                std::memset(out, 0xff, sizeof(out));
+                compose_bg_row(pattern, attr, fine_x, mask, out);
+                compose_bg_row_scalar(pattern, attr, fine_x, mask, expect);
+                CHECK(std::memcmp(out, expect, sizeof(out)) == 0);
+            }
+        }
+    }
+}
+
+} // namespace
+
+auto main() -> int {
+    matches_scalar();
+    return check_result();
+}
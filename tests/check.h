@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdio>
+
+// 失败时打印位置与表达式，测试结束时由 check_result() 返回失败次数
+inline int check_failures = 0;
+
+#define CHECK(expr)                                                            \
+    do {                                                                       \
+        if (!(expr)) {                                                         \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            ++check_failures;                                                  \
+        }                                                                      \
+    } while (false)
+
+inline auto check_result() -> int {
+    if (check_failures == 0) {
+        std::printf("ok\n");
+    }
+    return check_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#include "../nes/console.h"
+#include "check.h"
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// 程序放在 ram 的 0x0300，以 jmp 到自身结束
+auto load(bus &b, std::initializer_list<uint8_t> prog) -> void {
+    auto addr = 0x0300;
+    for (const auto byte : prog) {
+        b.ram()[addr++] = byte;
+    }
+    for (const auto byte : {0x4c, addr & 0xff, addr >> 8}) {
+        b.ram()[addr++] = static_cast<uint8_t>(byte);
+    }
+}
+
+auto run(bus &b, dispatch_mode mode, int steps) -> cpu {
+    auto c = cpu{b, mode};
+    c.r_sp_ = 0xfd;
+    c.r_pc_ = 0x0300;
+    for (auto i = 0; i < steps; ++i) {
+        c.next_inst();
+    }
+    return c;
+}
+
+// (zp),y：指针低字节与 y 有相同的位时，y 必须加在整个 16 位指针上
+auto indirect_y(dispatch_mode mode) -> void {
+    auto b = bus{};
+    b.ram()[0x10] = 0xf0; // 指针 0x01f0
+    b.ram()[0x11] = 0x01;
+    b.ram()[0x01f0] = 0x11;
+    b.ram()[0x0210] = 0x22;
+    load(b, {
+        0xa0, 0x20, // ldy #$20
+        0xb1, 0x10, // lda ($10),y
+    });
+    CHECK(run(b, mode, 2).a() == 0x22);
+}
+
+// 指针的高字节在零页内回绕
+auto zero_page_wrap(dispatch_mode mode) -> void {
+    auto b = bus{};
+    b.ram()[0xff] = 0x40; // 指针 0x0240
+    b.ram()[0x00] = 0x02;
+    b.ram()[0x0100] = 0x05;
+    b.ram()[0x0240] = 0x33;
+    b.ram()[0x0241] = 0x44;
+    b.ram()[0x0540] = 0x99;
+    b.ram()[0x0541] = 0x99;
+    load(b, {
+        0xa2, 0x01, // ldx #$01
+        0xa1, 0xfe, // lda ($fe,x)
+        0xaa,       // tax
+        0xa0, 0x01, // ldy #$01
+        0xb1, 0xff, // lda ($ff),y
+    });
+    auto c = run(b, mode, 5);
+    CHECK(c.x() == 0x33);
+    CHECK(c.a() == 0x44);
+}
+
+// 程序放在 nrom 卡带的 0x8000，写入临时文件后加载
+auto make_rom(std::initializer_list<uint8_t> prog) -> std::shared_ptr<cartridge> {
+    auto image = std::vector<uint8_t>{'N', 'E', 'S', 0x1a, 1, 1};
+    image.resize(16 + 0x4000 + 0x2000);
+    std::copy(prog.begin(), prog.end(), image.begin() + 16);
+    const auto path = std::filesystem::temp_directory_path() / "nes_cpu_test.nes";
+    std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char *>(image.data()), image.size());
+    auto cart = std::make_shared<cartridge>(path.string(), save_mode::memory);
+    std::filesystem::remove(path);
+    return cart;
+}
+
+auto load_rom(bus &b, std::initializer_list<uint8_t> prog) -> void {
+    b.load_cartridget(make_rom(prog));
+}
+
+// 循环中有跨页的读取与写入、标志入栈与子程序调用
+auto run_rom(bus &b, dispatch_mode mode) -> cpu {
+    for (auto i = 0; i < 0x10; ++i) {
+        b.ram()[0x10 + i] = static_cast<uint8_t>(i * 7);
+    }
+    load_rom(b, {
+        0xa2, 0x00,       // ldx #$00
+        0xa0, 0x01,       // ldy #$01
+        0xb5, 0x10,       // lda $10,x
+        0x18,             // clc
+        0x79, 0xff, 0x02, // adc $02ff,y
+        0x9d, 0xf8, 0x03, // sta $03f8,x
+        0x08,             // php
+        0x68,             // pla
+        0x9d, 0x00, 0x03, // sta $0300,x
+        0xe8,             // inx
+        0xe0, 0x10,       // cpx #$10
+        0xd0, 0xed,       // bne $8004
+        0x20, 0x1d, 0x80, // jsr $801d
+        0x4c, 0x1a, 0x80, // jmp $801a
+        0xc8,             // iny
+        0x60,             // rts
+    });
+    auto c = cpu{b, mode};
+    c.r_sp_ = 0xfd;
+    c.r_pc_ = 0x8000;
+    c.run_to(2000);
+    return c;
+}
+
+// checked 模式下翻译的块逐块与解释器比较，结果与 table 模式一致且没有发现不一致
+auto lockstep(dispatch_mode mode) -> void {
+    auto expect_bus = bus{};
+    auto expect = run_rom(expect_bus, dispatch_mode::table);
+    auto b = bus{};
+    auto c = run_rom(b, mode);
+    CHECK(c.check_errors() == 0);
+    CHECK(c.a() == expect.a());
+    CHECK(c.x() == 0x10);
+    CHECK(c.y() == 0x02);
+    CHECK(c.y() == expect.y());
+    CHECK(c.sp() == expect.sp());
+    CHECK(c.clocks() == expect.clocks());
+    for (auto addr = 0x0300; addr < 0x0410; ++addr) {
+        CHECK(b.ram()[addr] == expect_bus.ram()[addr]);
+    }
+}
+
+// make_console 按指定的方式执行，nrom 使用 basic_bus<nrom>
+auto console_mode(dispatch_mode mode) -> void {
+    auto c = make_console(make_rom({0x4c, 0x00, 0x80}), mode); // jmp $8000
+    CHECK(std::holds_alternative<std::unique_ptr<basic_bus<nrom>>>(c));
+    if (const auto b = std::get_if<std::unique_ptr<basic_bus<nrom>>>(&c)) {
+        CHECK((*b)->cpu().mode() == mode);
+        (*b)->cpu().r_pc_ = 0x8000;
+        (*b)->run_frame();
+        CHECK((*b)->cpu().pc() == 0x8000);
+    }
+}
+
+} // namespace
+
+auto main() -> int {
+    for (const auto mode : {dispatch_mode::table, dispatch_mode::threaded, dispatch_mode::block, dispatch_mode::checked,
+                            dispatch_mode::cached}) {
+        indirect_y(mode);
+        zero_page_wrap(mode);
+        lockstep(mode);
+        console_mode(mode);
+    }
+    return check_result();
+}
@@ -0,0 +1,101 @@
+#include "../nes/hash.h"
+#include "../nes/header_fixups.h"
+#include "check.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// 只用于测试的修正表，crc 不对应真实的 rom
+constexpr auto test_fixups = std::array<header_fixup, 4>{{
+    {.crc = 0x10000000, .mapper = 1},
+    {.crc = 0x20000000, .mirror = mirroring::vertical, .prg_nvram_size = 0x2000},
+    {.crc = 0x30000000, .prg_ram_size = 0x800, .timing = tv_system::pal},
+    {.crc = 0xf0000000, .mapper = 4, .submapper = 1, .prg_nvram_size = 0},
+}};
+static_assert(std::ranges::is_sorted(test_fixups, {}, &header_fixup::crc));
+
+auto find(uint32_t crc) -> const header_fixup * {
+    return find_header_fixup(crc, test_fixups);
+}
+
+// 表头、表中、表尾都能找到，表外与相邻条目之间找不到
+auto binary_search() -> void {
+    for (const auto &f : test_fixups) {
+        CHECK(find(f.crc) == &f);
+    }
+    CHECK(find(0) == nullptr);
+    CHECK(find(0x1fffffff) == nullptr);
+    CHECK(find(0x20000001) == nullptr);
+    CHECK(find(0xffffffff) == nullptr);
+    CHECK(find_header_fixup(0x10000000) == nullptr);
+}
+
+// 只覆盖填写了的字段；电池标志只在修正了 prg nvram 时改变
+auto override_fields() -> void {
+    const auto base = rom_info{
+        .mapper = 2,
+        .mirror = mirroring::horizontal,
+        .battery = true,
+        .prg_ram_size = 0,
+        .prg_nvram_size = 0x2000,
+    };
+
+    auto i = base;
+    apply_header_fixup(i, *find(0x10000000));
+    CHECK(i.fixed);
+    CHECK(i.mapper == 1);
+    CHECK(i.mirror == mirroring::horizontal);
+    CHECK(i.battery);
+    CHECK(i.prg_nvram_size == 0x2000);
+
+    i = base;
+    apply_header_fixup(i, *find(0x30000000));
+    CHECK(i.mapper == 2);
+    CHECK(i.prg_ram_size == 0x800);
+    CHECK(i.timing == tv_system::pal);
+    CHECK(i.battery);
+
+    i = base;
+    apply_header_fixup(i, *find(0xf0000000));
+    CHECK(i.mapper == 4);
+    CHECK(i.submapper == 1);
+    CHECK(!i.battery);
+    CHECK(i.prg_nvram_size == 0);
+
+    i = rom_info{};
+    apply_header_fixup(i, *find(0x20000000));
+    CHECK(i.mirror == mirroring::vertical);
+    CHECK(i.battery);
+    CHECK(i.prg_nvram_size == 0x2000);
+}
+
+// 加载时的 crc 只包含 prg 与 chr，trainer 与文件尾部的多余数据不影响
+auto image_crc() -> void {
+    auto image = std::vector<uint8_t>{'N', 'E', 'S', 0x1a, 1, 1, 0x04};
+    image.resize(16 + 512 + 0x4000 + 0x2000 + 100);
+    for (auto i = size_t{16}; i < image.size(); ++i) {
+        image[i] = static_cast<uint8_t>(i * 31);
+    }
+    const auto path = std::filesystem::temp_directory_path() / "nes_header_fixup_test.nes";
+    std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char *>(image.data()), image.size());
+    const auto rom = rom_image::open(path.string());
+    std::filesystem::remove(path);
+    CHECK(rom != nullptr);
+    if (rom) {
+        const auto prg = std::span{image}.subspan(16 + 512, 0x4000);
+        const auto chr = std::span{image}.subspan(16 + 512 + 0x4000, 0x2000);
+        CHECK(rom->crc() == crc32(chr, crc32(prg)));
+        CHECK(!rom->info().fixed);
+    }
+}
+
+} // namespace
+
+auto main() -> int {
+    binary_search();
+    override_fields();
+    image_crc();
+    return check_result();
+}
@@ -0,0 +1,138 @@
+// 将 nrom（mapper 0）卡带的 prg rom 预编译为 c++ 代码。
+// 用法：nes_recompile <rom.nes> <out.cpp> [entry]
+// 生成的文件与 nes 库一起编译，然后通过 load_aot(&entry) 启用。入口是 cpu 类型的模板，
+// 为每种 bus 显式实例化，单独使用的 cpu 与 make_console 创建的 basic_bus<nrom> 都可以加载：
+//     template <typename Cpu>
+//     auto entry(Cpu &c) -> bool;
+// 每条指令通过 cpu::aot_op 执行，周期立即计入 clocks_，io 处理函数看到的时刻与解释器相同
+#include "../nes/bus.h"
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <map>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+class recompiler {
+  public:
+    explicit recompiler(std::span<const uint8_t> prg) : prg_(prg) {}
+
+    // 从中断向量出发，沿直接跳转、子程序调用和分支遍历代码
+    auto discover() -> void {
+        for (const auto vec : {0xfffa, 0xfffc, 0xfffe}) {
+            push(read(vec) | (read(vec + 1) << 8));
+        }
+        while (!pending_.empty()) {
+            const auto addr = pending_.back();
+            pending_.pop_back();
+            if (!blocks_.contains(addr)) {
+                decode_block(addr);
+            }
+        }
+    }
+
+    auto emit(std::ostream &os, std::string_view rom, std::string_view entry) -> void {
+        os << std::format("// 由 nes_recompile 从 {} 生成，请勿手动修改\n", rom);
+        os << "#include \"nes/bus.h\"\n\nnamespace {\n";
+        for (const auto &[start, ops] : blocks_) {
+            os << std::format("\ntemplate <typename Cpu>\nauto block_{:04x}(Cpu &c) -> void {{\n", start);
+            for (const auto &[pc, opcode] : ops) {
+                os << std::format("    Cpu::template aot_op<0x{:02x}>(c, 0x{:04x}); // {}\n", opcode, (pc + 1) & 0xffff,
+                                  cpu::inst_infos[opcode].name);
+            }
+            os << "}\n";
+        }
+        os << "\n} // namespace\n\n";
+
+        // 间接跳转、rts 等无法静态确定的目标在运行时查表，查不到时由解释器执行
+        os << std::format("template <typename Cpu>\nauto {}(Cpu &c) -> bool {{\n    switch (c.pc()) {{\n", entry);
+        for (const auto &[start, ops] : blocks_) {
+            os << std::format("        case 0x{:04x}:\n            block_{:04x}(c);\n            return true;\n", start, start);
+        }
+        os << "        default:\n            return false;\n    }\n}\n";
+        os << std::format("\n#define NES_INSTANTIATE_AOT(B) template auto {}(basic_cpu<B> &c) -> bool;\n", entry);
+        os << "NES_FOR_EACH_BUS(NES_INSTANTIATE_AOT)\n#undef NES_INSTANTIATE_AOT\n";
+    }
+
+    auto block_count() -> size_t { return blocks_.size(); }
+
+  private:
+    // 16KB 的 prg rom 在 0xc000 处镜像
+    auto read(uint32_t addr) const -> uint8_t { return prg_[(addr - 0x8000) % prg_.size()]; }
+
+    // 只预编译 prg rom 中的代码，ram 中的代码交给解释器
+    auto push(uint32_t addr) -> void {
+        if (addr >= 0x8000 && addr <= 0xffff) {
+            pending_.push_back(addr);
+        }
+    }
+
+    auto decode_block(uint16_t start) -> void {
+        constexpr auto max_block_ops = 64;
+        auto &ops = blocks_[start];
+        auto pc = uint32_t{start};
+        while (ops.size() < max_block_ops) {
+            const auto opcode = read(pc);
+            const auto &inst = cpu::inst_table[opcode];
+            const auto &info = cpu::inst_infos[opcode];
+            const auto next = pc + inst.len;
+            if (next > 0x10000) {
+                break;
+            }
+            ops.push_back({static_cast<uint16_t>(pc), opcode});
+            if (inst.mod == addr_mode::REL) {
+                push(next + static_cast<int8_t>(read(pc + 1)));
+                push(next);
+            } else if (info.name == "JSR") {
+                push(read(pc + 1) | (read(pc + 2) << 8));
+                push(next);
+            } else if (info.name == "JMP" && inst.mod == addr_mode::ABS) {
+                push(read(pc + 1) | (read(pc + 2) << 8));
+            }
+            if (info.name == "CLI" || info.name == "PLP") {
+                push(next); // 只为回到 bus 检查中断而结束块，之后的代码照常预编译
+            }
+            if (info.ends_block) {
+                break;
+            }
+            pc = next;
+        }
+        if (ops.empty()) {
+            blocks_.erase(start);
+        }
+    }
+
+  private:
+    std::span<const uint8_t> prg_;
+    std::vector<uint32_t> pending_;
+    std::map<uint16_t, std::vector<std::pair<uint16_t, uint8_t>>> blocks_; // 起始地址 -> (地址, 操作码)
+};
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <rom.nes> <out.cpp> [entry]\n", argv[0]);
+        return 1;
+    }
+
+    auto cart = cartridge{argv[1], save_mode::memory}; // 只读取 prg rom，不创建 .sav
+    if (!cart.valid() || cart.mapper_id() != 0) {
+        std::fprintf(stderr, "%s: only valid nrom (mapper 0) cartridges are supported\n", argv[1]);
+        return 1;
+    }
+
+    auto rc = recompiler{cart.prg_rom()};
+    rc.discover();
+    auto ofs = std::ofstream{argv[2]};
+    rc.emit(ofs, argv[1], argc > 3 ? argv[3] : "nes_aot_entry");
+    if (!ofs) {
+        std::fprintf(stderr, "%s: write failed\n", argv[2]);
+        return 1;
+    }
+    std::printf("%zu blocks\n", rc.block_count());
+    return 0;
+}